@@ -0,0 +1,246 @@
+/*
+ * Copyright (C) 2026 Fanout, Inc.
+ *
+ * This file is part of Zurl.
+ *
+ * $FANOUT_BEGIN_LICENSE:GPL$
+ *
+ * Zurl is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zurl is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Zurl may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#include "accesslog.h"
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <atomic>
+#include <QByteArray>
+#include <QThread>
+#include <QSemaphore>
+#include <QMutex>
+#include "log.h"
+
+// if the writer falls this far behind, drop lines rather than grow
+#define QUEUE_MAX 100000
+
+// level of the node that tells the writer to stop
+#define STOP_LEVEL -1
+
+namespace {
+
+class Node
+{
+public:
+	std::atomic<Node*> next;
+	int level;
+	QByteArray line;
+
+	Node() :
+		next(0),
+		level(0)
+	{
+	}
+};
+
+// multiple producer, single consumer queue (Vyukov). pushing is a single
+//   atomic exchange, and popping needs no atomic read-modify-write
+class MpscQueue
+{
+public:
+	MpscQueue() :
+		head(&stub),
+		tail(&stub)
+	{
+	}
+
+	void push(Node *n)
+	{
+		n->next.store(0, std::memory_order_relaxed);
+		Node *prev = head.exchange(n, std::memory_order_acq_rel);
+		prev->next.store(n, std::memory_order_release);
+	}
+
+	// returns null if empty, or if a push is still in progress
+	Node *pop()
+	{
+		Node *t = tail;
+		Node *next = t->next.load(std::memory_order_acquire);
+
+		if(t == &stub)
+		{
+			if(!next)
+				return 0;
+
+			tail = next;
+			t = next;
+			next = next->next.load(std::memory_order_acquire);
+		}
+
+		if(next)
+		{
+			tail = next;
+			return t;
+		}
+
+		if(t != head.load(std::memory_order_acquire))
+			return 0;
+
+		push(&stub);
+
+		next = t->next.load(std::memory_order_acquire);
+		if(next)
+		{
+			tail = next;
+			return t;
+		}
+
+		return 0;
+	}
+
+private:
+	std::atomic<Node*> head;
+	Node *tail;
+	Node stub;
+};
+
+class WriterThread : public QThread
+{
+public:
+	MpscQueue queue;
+	QSemaphore available;
+	std::atomic<int> pending;
+	std::atomic<int> dropped;
+
+	WriterThread() :
+		pending(0),
+		dropped(0)
+	{
+		setObjectName("accesslog");
+	}
+
+	void enqueue(Node *n)
+	{
+		queue.push(n);
+		available.release();
+	}
+
+protected:
+	virtual void run()
+	{
+		while(true)
+		{
+			available.acquire();
+
+			// a count guarantees a completed push, but an earlier push
+			//   may not be linked in yet
+			Node *n;
+			while(!(n = queue.pop()))
+				QThread::yieldCurrentThread();
+
+			if(n->level == STOP_LEVEL)
+			{
+				delete n;
+				break;
+			}
+
+			--pending;
+
+			int d = dropped.exchange(0);
+			if(d > 0)
+				log_warning("access log fell behind, dropped %d lines", d);
+
+			log(n->level, "%s", n->line.constData());
+			delete n;
+		}
+	}
+};
+
+}
+
+static QMutex g_mutex;
+static std::atomic<WriterThread*> g_writer(0);
+
+void accesslog_start()
+{
+	QMutexLocker locker(&g_mutex);
+
+	if(g_writer.load())
+		return;
+
+	WriterThread *writer = new WriterThread;
+	writer->start();
+	g_writer.store(writer);
+}
+
+void accesslog_stop()
+{
+	QMutexLocker locker(&g_mutex);
+
+	WriterThread *writer = g_writer.exchange(0);
+	if(!writer)
+		return;
+
+	// lines queued before this are written first
+	Node *n = new Node;
+	n->level = STOP_LEVEL;
+	writer->enqueue(n);
+
+	writer->wait();
+	delete writer;
+}
+
+void accesslog_write(int level, const char *fmt, ...)
+{
+	if(log_outputLevel() < level)
+		return;
+
+	va_list ap;
+	va_start(ap, fmt);
+	QByteArray line;
+	va_list ap2;
+	va_copy(ap2, ap);
+	int size = vsnprintf(0, 0, fmt, ap2);
+	va_end(ap2);
+	if(size > 0)
+	{
+		line.resize(size);
+		vsnprintf(line.data(), size + 1, fmt, ap);
+	}
+	va_end(ap);
+
+	WriterThread *writer = g_writer.load();
+	if(!writer)
+	{
+		log(level, "%s", line.constData());
+		return;
+	}
+
+	if(writer->pending.fetch_add(1) >= QUEUE_MAX)
+	{
+		--writer->pending;
+		++writer->dropped;
+		return;
+	}
+
+	Node *n = new Node;
+	n->level = level;
+	n->line = line;
+	writer->enqueue(n);
+}
@@ -0,0 +1,344 @@
+/*
+ * Copyright (C) 2026 Fanout, Inc.
+ *
+ * This file is part of Zurl.
+ *
+ * $FANOUT_BEGIN_LICENSE:GPL$
+ *
+ * Zurl is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zurl is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Zurl may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#include "accesspolicy.h"
+
+#include <QVector>
+#include <QVarLengthArray>
+#include <QSet>
+#include <QPair>
+#include <QHostAddress>
+
+// binary trie of address prefixes, one bit per level
+class BitTrie
+{
+public:
+	class Node
+	{
+	public:
+		int child[2];
+		bool terminal;
+
+		Node() :
+			terminal(false)
+		{
+			child[0] = -1;
+			child[1] = -1;
+		}
+	};
+
+	QVector<Node> nodes;
+
+	BitTrie() :
+		nodes(1)
+	{
+	}
+
+	bool isEmpty() const
+	{
+		return (nodes.count() == 1 && !nodes[0].terminal);
+	}
+
+	void insert(const quint8 *addr, int prefixBits)
+	{
+		int at = 0;
+		for(int n = 0; n < prefixBits; ++n)
+		{
+			int bit = (addr[n / 8] >> (7 - n % 8)) & 1;
+			if(nodes[at].child[bit] == -1)
+			{
+				nodes[at].child[bit] = nodes.count();
+				nodes += Node();
+			}
+
+			at = nodes[at].child[bit];
+		}
+
+		nodes[at].terminal = true;
+	}
+
+	// true if any inserted prefix covers the address
+	bool match(const quint8 *addr, int bits) const
+	{
+		int at = 0;
+		for(int n = 0; n < bits; ++n)
+		{
+			if(nodes[at].terminal)
+				return true;
+
+			int bit = (addr[n / 8] >> (7 - n % 8)) & 1;
+			at = nodes[at].child[bit];
+			if(at == -1)
+				return false;
+		}
+
+		return nodes[at].terminal;
+	}
+};
+
+// trie of strings, one character per level. strings can be inserted
+//   reversed, to find suffixes
+class CharTrie
+{
+public:
+	class Node
+	{
+	public:
+		QVarLengthArray<QPair<ushort, int>, 2> children;
+		bool terminal;
+
+		Node() :
+			terminal(false)
+		{
+		}
+
+		int find(ushort c) const
+		{
+			for(int n = 0; n < children.count(); ++n)
+			{
+				if(children[n].first == c)
+					return children[n].second;
+			}
+
+			return -1;
+		}
+	};
+
+	bool reversed;
+	QVector<Node> nodes;
+
+	CharTrie(bool _reversed) :
+		reversed(_reversed),
+		nodes(1)
+	{
+	}
+
+	bool isEmpty() const
+	{
+		return (nodes.count() == 1 && !nodes[0].terminal);
+	}
+
+	void insert(const QString &s)
+	{
+		int at = 0;
+		for(int n = 0; n < s.length(); ++n)
+		{
+			ushort c = s[reversed ? s.length() - 1 - n : n].unicode();
+			int next = nodes[at].find(c);
+			if(next == -1)
+			{
+				next = nodes.count();
+				nodes[at].children.append(qMakePair(c, next));
+				nodes += Node();
+			}
+
+			at = next;
+		}
+
+		nodes[at].terminal = true;
+	}
+
+	// true if any inserted string is a prefix of s (or a suffix, if
+	//   reversed)
+	bool match(const QString &s) const
+	{
+		int at = 0;
+		for(int n = 0; n < s.length(); ++n)
+		{
+			if(nodes[at].terminal)
+				return true;
+
+			at = nodes[at].find(s[reversed ? s.length() - 1 - n : n].unicode());
+			if(at == -1)
+				return false;
+		}
+
+		return nodes[at].terminal;
+	}
+};
+
+class AccessPolicy::RuleSet
+{
+public:
+	BitTrie v4;
+	BitTrie v6;
+	CharTrie prefixes; // "start*"
+	CharTrie suffixes; // "*end", and "*" matching everything
+	QList<QPair<QString, QString> > wildcards; // "start*end"
+	QSet<QString> exact;
+
+	RuleSet() :
+		prefixes(false),
+		suffixes(true)
+	{
+	}
+
+	bool hasSubnets() const
+	{
+		return (!v4.isEmpty() || !v6.isEmpty());
+	}
+
+	bool hasStrings() const
+	{
+		return (!prefixes.isEmpty() || !suffixes.isEmpty() || !wildcards.isEmpty() || !exact.isEmpty());
+	}
+
+	void add(const QString &exp)
+	{
+		QString folded = exp.toCaseFolded();
+
+		if(exp.contains('/'))
+		{
+			QPair<QHostAddress, int> sn = QHostAddress::parseSubnet(exp);
+			if(!sn.first.isNull())
+			{
+				if(sn.first.protocol() == QAbstractSocket::IPv4Protocol)
+				{
+					quint32 a = sn.first.toIPv4Address();
+					quint8 bytes[4] = { (quint8)(a >> 24), (quint8)(a >> 16), (quint8)(a >> 8), (quint8)a };
+					v4.insert(bytes, sn.second);
+				}
+				else
+				{
+					Q_IPV6ADDR a = sn.first.toIPv6Address();
+					v6.insert(a.c, sn.second);
+				}
+
+				// names are still compared to the rule as written
+				exact += folded;
+				return;
+			}
+		}
+
+		int at = folded.indexOf('*');
+		if(at != -1)
+		{
+			QString start = folded.mid(0, at);
+			QString end = folded.mid(at + 1);
+
+			if(start.isEmpty())
+				suffixes.insert(end);
+			else if(end.isEmpty())
+				prefixes.insert(start);
+			else
+				wildcards += qMakePair(start, end);
+
+			return;
+		}
+
+		exact += folded;
+	}
+
+	// folded is the case folded input, addr is its parsed form if it is
+	//   an address
+	bool match(const QString &folded, const QHostAddress *addr) const
+	{
+		if(addr)
+		{
+			if(addr->protocol() == QAbstractSocket::IPv4Protocol)
+			{
+				quint32 a = addr->toIPv4Address();
+				quint8 bytes[4] = { (quint8)(a >> 24), (quint8)(a >> 16), (quint8)(a >> 8), (quint8)a };
+				if(v4.match(bytes, 32))
+					return true;
+			}
+			else if(addr->protocol() == QAbstractSocket::IPv6Protocol)
+			{
+				Q_IPV6ADDR a = addr->toIPv6Address();
+				if(v6.match(a.c, 128))
+					return true;
+			}
+		}
+
+		if(exact.contains(folded) || prefixes.match(folded) || suffixes.match(folded))
+			return true;
+
+		for(int n = 0; n < wildcards.count(); ++n)
+		{
+			const QPair<QString, QString> &w = wildcards[n];
+			if(folded.startsWith(w.first) && folded.endsWith(w.second))
+				return true;
+		}
+
+		return false;
+	}
+};
+
+AccessPolicy::AccessPolicy() :
+	defaultAllow_(true),
+	allow_(new RuleSet),
+	deny_(new RuleSet)
+{
+}
+
+void AccessPolicy::setRules(bool defaultAllow, const QStringList &allowExps, const QStringList &denyExps)
+{
+	RuleSet *allow = new RuleSet;
+	foreach(const QString &exp, allowExps)
+		allow->add(exp);
+
+	RuleSet *deny = new RuleSet;
+	foreach(const QString &exp, denyExps)
+		deny->add(exp);
+
+	defaultAllow_ = defaultAllow;
+	allow_ = QSharedPointer<const RuleSet>(allow);
+	deny_ = QSharedPointer<const RuleSet>(deny);
+}
+
+bool AccessPolicy::isAllowed(const QString &in) const
+{
+	if(allow_->hasSubnets() || deny_->hasSubnets())
+	{
+		QHostAddress addr(in);
+		if(!addr.isNull())
+			return check(in, &addr);
+	}
+
+	return check(in, 0);
+}
+
+bool AccessPolicy::isAllowed(const QHostAddress &addr) const
+{
+	// only name rules need the string form
+	QString in;
+	if(allow_->hasStrings() || deny_->hasStrings())
+		in = addr.toString();
+
+	return check(in, &addr);
+}
+
+bool AccessPolicy::check(const QString &in, const QHostAddress *addr) const
+{
+	QString folded = in.toCaseFolded();
+
+	if(defaultAllow_)
+		return (!deny_->match(folded, addr) || allow_->match(folded, addr));
+	else
+		return (allow_->match(folded, addr) && !deny_->match(folded, addr));
+}
@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2026 Fanout, Inc.
+ *
+ * This file is part of Zurl.
+ *
+ * $FANOUT_BEGIN_LICENSE:GPL$
+ *
+ * Zurl is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zurl is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Zurl may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#ifndef ACCESSPOLICY_H
+#define ACCESSPOLICY_H
+
+#include <QStringList>
+#include <QSharedPointer>
+
+class QHostAddress;
+
+// allow/deny rules compiled for fast lookup. a rule is either a subnet in
+//   CIDR notation, a pattern with one '*' wildcard, or an exact name or
+//   address, all compared case insensitively. subnets are kept in a bit
+//   trie per address family, and wildcards in character tries, so lookup
+//   cost depends on the length of the input rather than the number of
+//   rules. immutable once set up, so it can be shared between threads
+
+class AccessPolicy
+{
+public:
+	AccessPolicy();
+
+	// with default allow, input is allowed unless it matches a deny rule
+	//   and no allow rule. with default deny, input is allowed only if it
+	//   matches an allow rule and no deny rule
+	void setRules(bool defaultAllow, const QStringList &allowExps, const QStringList &denyExps);
+
+	// host name or address in string form
+	bool isAllowed(const QString &in) const;
+
+	bool isAllowed(const QHostAddress &addr) const;
+
+private:
+	class RuleSet;
+
+	bool defaultAllow_;
+	QSharedPointer<const RuleSet> allow_;
+	QSharedPointer<const RuleSet> deny_;
+
+	bool check(const QString &in, const QHostAddress *addr) const;
+};
+
+#endif
@@ -30,7 +30,7 @@
 
 #include <assert.h>
 #include <QHostInfo>
-#include "log.h"
+#include "logutil.h"
 
 class AddressResolver::Private : public QObject
 {
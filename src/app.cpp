@@ -31,24 +31,34 @@
 #include <stdio.h>
 #include <assert.h>
 #include <QHash>
+#include <QThread>
 #include <QUuid>
+#include <QUrl>
 #include <QSettings>
+#include <QTimer>
+#include <QElapsedTimer>
 #include <QHostAddress>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QJsonArray>
+#include <zmq.h>
 
 #include "qzmqsocket.h"
 #include "qzmqreqmessage.h"
-#include "qzmqvalve.h"
 #include "processquit.h"
 #include "tnetstring.h"
 #include "zhttprequestpacket.h"
 #include "zhttpresponsepacket.h"
 #include "httprequest.h"
 #include "appconfig.h"
-#include "log.h"
+#include "logutil.h"
+#include "accesslog.h"
 #include "worker.h"
+#include "engine.h"
+#include "zhttpcodec.h"
+#include "batchvalve.h"
+#include "zmqpublisher.h"
+#include "stats.h"
 
 #define VERSION "1.12.0"
 
@@ -64,119 +74,6 @@ static void cleanStringList(QStringList *in)
 	}
 }
 
-// return true if item modified
-static bool convertToJsonStyleInPlace(QVariant *in)
-{
-	// Hash -> Map
-	// ByteArray (UTF-8) -> String
-
-	bool changed = false;
-
-	int type = in->type();
-	if(type == QVariant::Hash)
-	{
-		QVariantMap vmap;
-		QVariantHash vhash = in->toHash();
-		QHashIterator<QString, QVariant> it(vhash);
-		while(it.hasNext())
-		{
-			it.next();
-			QVariant i = it.value();
-			convertToJsonStyleInPlace(&i);
-			vmap[it.key()] = i;
-		}
-
-		*in = vmap;
-		changed = true;
-	}
-	else if(type == QVariant::List)
-	{
-		QVariantList vlist = in->toList();
-		for(int n = 0; n < vlist.count(); ++n)
-		{
-			QVariant i = vlist.at(n);
-			convertToJsonStyleInPlace(&i);
-			vlist[n] = i;
-		}
-
-		*in = vlist;
-		changed = true;
-	}
-	else if(type == QVariant::ByteArray)
-	{
-		*in = QVariant(QString::fromUtf8(in->toByteArray()));
-		changed = true;
-	}
-
-	return changed;
-}
-
-// return true if item modified
-static bool convertFromJsonStyleInPlace(QVariant *in)
-{
-	// Map -> Hash
-	// String -> ByteArray (UTF-8)
-
-	bool changed = false;
-
-	int type = in->type();
-	if(type == QVariant::Map)
-	{
-		QVariantHash vhash;
-		QVariantMap vmap = in->toMap();
-		QMapIterator<QString, QVariant> it(vmap);
-		while(it.hasNext())
-		{
-			it.next();
-			QVariant i = it.value();
-			convertFromJsonStyleInPlace(&i);
-			vhash[it.key()] = i;
-		}
-
-		*in = vhash;
-		changed = true;
-	}
-	else if(type == QVariant::List)
-	{
-		QVariantList vlist = in->toList();
-		for(int n = 0; n < vlist.count(); ++n)
-		{
-			QVariant i = vlist.at(n);
-			convertFromJsonStyleInPlace(&i);
-			vlist[n] = i;
-		}
-
-		*in = vlist;
-		changed = true;
-	}
-	else if(type == QVariant::String)
-	{
-		*in = QVariant(in->toString().toUtf8());
-		changed = true;
-	}
-	else if(type != QVariant::Bool && type != QVariant::Double && in->canConvert(QVariant::Int))
-	{
-		*in = in->toInt();
-		changed = true;
-	}
-
-	return changed;
-}
-
-static QVariant convertToJsonStyle(const QVariant &in)
-{
-	QVariant v = in;
-	convertToJsonStyleInPlace(&v);
-	return v;
-}
-
-static QVariant convertFromJsonStyle(const QVariant &in)
-{
-	QVariant v = in;
-	convertFromJsonStyleInPlace(&v);
-	return v;
-}
-
 class App::Private : public QObject
 {
 	Q_OBJECT
@@ -192,14 +89,25 @@ public:
 	App *q;
 	QZmq::Socket *in_sock;
 	QZmq::Socket *in_stream_sock;
-	QZmq::Socket *out_sock;
+	ZmqPublisher *out_sock;
 	QZmq::Socket *in_req_sock;
-	QZmq::Valve *in_valve;
-	QZmq::Valve *in_req_valve;
+	ZmqPublisher *stats_sock;
+	void *publisherContext; // shared by out_sock and stats_sock
+	QTimer *statsTimer;
+	QList<QUrl> prewarmUris;
+	int prewarmCount;
+	QTimer *prewarmTimer;
+	QElapsedTimer valveClosedTime;
+	BatchValve *in_valve;
+	BatchValve *in_stream_valve;
+	BatchValve *in_req_valve;
 	AppConfig config;
-	QSet<Worker*> workers;
-	QHash<QByteArray, Worker*> streamWorkersByRid;
-	QHash<Worker*, QList<QByteArray> > reqHeadersByWorker;
+	QList<Engine*> engines;
+	QList<QThread*> engineThreads;
+	int workerCount;
+	int nextEngine;
+	bool directCodec;
+	bool validateCodec;
 
 	Private(App *_q) :
 		QObject(_q),
@@ -208,13 +116,35 @@ public:
 		in_stream_sock(0),
 		out_sock(0),
 		in_req_sock(0),
+		stats_sock(0),
+		publisherContext(0),
+		statsTimer(0),
+		prewarmCount(1),
+		prewarmTimer(0),
 		in_valve(0),
-		in_req_valve(0)
+		in_stream_valve(0),
+		in_req_valve(0),
+		workerCount(0),
+		nextEngine(0),
+		directCodec(true),
+		validateCodec(false)
 	{
 		connect(ProcessQuit::instance(), &ProcessQuit::quit, this, &Private::doQuit);
 		connect(ProcessQuit::instance(), &ProcessQuit::hup, this, &Private::reload);
 	}
 
+	~Private()
+	{
+		stopEngines();
+		accesslog_stop();
+
+		// the context can only be terminated once its sockets are closed
+		delete out_sock;
+		delete stats_sock;
+		if(publisherContext)
+			zmq_ctx_term(publisherContext);
+	}
+
 	void start()
 	{
 		QStringList args = QCoreApplication::instance()->arguments();
@@ -286,6 +216,8 @@ public:
 			}
 		}
 
+		accesslog_start();
+
 		log_info("starting...");
 
 		if(options.contains("config") && options.value("config").isEmpty())
@@ -323,14 +255,34 @@ public:
 		QString in_stream_spec = settings.value("in_stream_spec").toString();
 		QString out_spec = settings.value("out_spec").toString();
 		QString in_req_spec = settings.value("in_req_spec").toString();
+		QString stats_spec = settings.value("stats_spec").toString();
+		int statsInterval = settings.value("stats_interval", 10).toInt();
 		QString ipcFileModeStr = settings.value("ipc_file_mode").toString();
 		config.allowIPv6 = settings.value("allow_ipv6", false).toBool();
 		config.maxWorkers = settings.value("max_open_requests", -1).toInt();
+		config.maxHostRequests = settings.value("max_host_requests", 0).toInt();
+		config.maxHostQueue = settings.value("max_host_queue", 100).toInt();
+		int maxHostConnections = settings.value("max_host_connections", 0).toInt();
+		int maxTotalConnections = settings.value("max_total_connections", 0).toInt();
 		config.sessionBufferSize = settings.value("buffer_size", 200000).toInt();
+		qint64 memoryBudget = settings.value("memory_budget", 0).toLongLong();
 		config.activityTimeout = settings.value("timeout", 600).toInt();
 		config.persistentConnectionMaxTime = settings.value("connection_max_time", 60 * 60 * 2).toInt();
+		config.engineThreads = settings.value("engine_threads", 1).toInt();
+		config.coalesceInterval = settings.value("coalesce_interval", 0).toInt();
+		config.flushSize = settings.value("flush_size", 0).toInt();
+		config.flushDelay = settings.value("flush_delay", 20).toInt();
+		config.http2 = settings.value("http2", false).toBool();
+		int http2MaxStreams = settings.value("http2_max_streams", 100).toInt();
+		directCodec = settings.value("direct_codec", true).toBool();
+		validateCodec = settings.value("validate_codec", false).toBool();
 		int inHwm = settings.value("in_hwm", 1000).toInt();
+		int readBatchSize = settings.value("read_batch_size", 100).toInt();
 		int outHwm = settings.value("out_hwm", 1000).toInt();
+		QString eventBackend = settings.value("event_backend", "qt").toString();
+		QStringList prewarmHosts = settings.value("prewarm_hosts").toStringList();
+		prewarmCount = settings.value("prewarm_count", 1).toInt();
+		int prewarmInterval = settings.value("prewarm_interval", 0).toInt();
 
 		if((!in_spec.isEmpty() || !in_stream_spec.isEmpty() || !out_spec.isEmpty()) && (in_spec.isEmpty() || in_stream_spec.isEmpty() || out_spec.isEmpty()))
 		{
@@ -346,6 +298,15 @@ public:
 			return;
 		}
 
+		// the publishers don't share the zmq context of the other sockets,
+		//   so nothing in the process could connect to them over inproc
+		if(out_spec.startsWith("inproc://") || stats_spec.startsWith("inproc://"))
+		{
+			log_error("inproc is not supported for out_spec or stats_spec");
+			emit q->quit();
+			return;
+		}
+
 		int ipcFileMode = -1;
 		if(!ipcFileModeStr.isEmpty())
 		{
@@ -377,13 +338,60 @@ public:
 			config.defaultPolicy = "allow";
 		}
 
+		cleanStringList(&prewarmHosts);
+		foreach(const QString &s, prewarmHosts)
+		{
+			QUrl uri(s, QUrl::StrictMode);
+			if(!uri.isValid() || (uri.scheme() != "https" && uri.scheme() != "http") || uri.host().isEmpty())
+			{
+				log_error("invalid prewarm_hosts entry: %s", qPrintable(s));
+				emit q->quit();
+				return;
+			}
+
+			prewarmUris += uri;
+		}
+
+		if(prewarmCount < 1)
+		{
+			log_error("prewarm_count must be at least 1");
+			emit q->quit();
+			return;
+		}
+
 		config.allowExps = settings.value("allow").toStringList();
 		config.denyExps = settings.value("deny").toStringList();
 
 		cleanStringList(&config.allowExps);
 		cleanStringList(&config.denyExps);
 
+		config.accessPolicy.setRules(config.defaultPolicy == "allow", config.allowExps, config.denyExps);
+
+		if(config.engineThreads < 1)
+		{
+			log_error("engine_threads must be at least 1");
+			emit q->quit();
+			return;
+		}
+
+		if(eventBackend == "epoll")
+		{
+			HttpRequest::setEventBackend(HttpRequest::EpollEventBackend);
+		}
+		else if(eventBackend != "qt")
+		{
+			log_error("event_backend must be one of: qt, epoll");
+			emit q->quit();
+			return;
+		}
+
 		HttpRequest::setPersistentConnectionMaxTime(config.persistentConnectionMaxTime);
+		HttpRequest::setMaxBufferSize(config.sessionBufferSize);
+		HttpRequest::setMemoryBudget(memoryBudget);
+		HttpRequest::setMaxConcurrentStreams(http2MaxStreams);
+		HttpRequest::setConnectionLimits(maxHostConnections, maxTotalConnections);
+
+		startEngines();
 
 		if(!in_spec.isEmpty())
 		{
@@ -394,8 +402,10 @@ public:
 			if(!bindSpec(in_sock, "in_spec", in_spec, ipcFileMode))
 				return;
 
-			in_valve = new QZmq::Valve(in_sock, this);
-			connect(in_valve, &QZmq::Valve::readyRead, this, &Private::in_readyRead);
+			in_valve = new BatchValve(in_sock, this);
+			in_valve->setBatchSize(readBatchSize);
+			in_valve->setStatsCounters(Stats::InBatches, Stats::InMessages);
+			connect(in_valve, &BatchValve::readyRead, this, &Private::in_readyRead);
 		}
 
 		if(!in_stream_spec.isEmpty())
@@ -405,19 +415,24 @@ public:
 			in_stream_sock->setIdentity(config.clientId);
 			in_stream_sock->setHwm(inHwm);
 
-			connect(in_stream_sock, &QZmq::Socket::readyRead, this, &Private::in_stream_readyRead);
-
 			if(!bindSpec(in_stream_sock, "in_stream_spec", in_stream_spec, ipcFileMode))
 				return;
+
+			// stream packets are never throttled, so this valve stays open
+			in_stream_valve = new BatchValve(in_stream_sock, this);
+			in_stream_valve->setBatchSize(readBatchSize);
+			in_stream_valve->setStatsCounters(Stats::InStreamBatches, Stats::InStreamMessages);
+			connect(in_stream_valve, &BatchValve::readyRead, this, &Private::in_stream_readyRead);
 		}
 
 		if(!out_spec.isEmpty())
 		{
-			out_sock = new QZmq::Socket(QZmq::Socket::Pub, this);
+			if(!publisherContext)
+				publisherContext = zmq_ctx_new();
+
+			out_sock = new ZmqPublisher(publisherContext, this);
 
-			out_sock->setWriteQueueEnabled(false);
 			out_sock->setHwm(outHwm);
-			out_sock->setShutdownWaitTime(0);
 
 			if(!bindSpec(out_sock, "out_spec", out_spec, ipcFileMode))
 				return;
@@ -432,19 +447,166 @@ public:
 			if(!bindSpec(in_req_sock, "in_req_spec", in_req_spec, ipcFileMode))
 				return;
 
-			in_req_valve = new QZmq::Valve(in_req_sock, this);
-			connect(in_req_valve, &QZmq::Valve::readyRead, this, &Private::in_req_readyRead);
+			in_req_valve = new BatchValve(in_req_sock, this);
+			in_req_valve->setBatchSize(readBatchSize);
+			in_req_valve->setStatsCounters(Stats::InReqBatches, Stats::InReqMessages);
+			connect(in_req_valve, &BatchValve::readyRead, this, &Private::in_req_readyRead);
+		}
+
+		if(!stats_spec.isEmpty())
+		{
+			if(!publisherContext)
+				publisherContext = zmq_ctx_new();
+
+			stats_sock = new ZmqPublisher(publisherContext, this);
+
+			if(!bindSpec(stats_sock, "stats_spec", stats_spec, ipcFileMode))
+				return;
+
+			statsTimer = new QTimer(this);
+			connect(statsTimer, &QTimer::timeout, this, &Private::statsTimer_timeout);
+			statsTimer->start(qMax(statsInterval, 1) * 1000);
+		}
+
+		if(!prewarmUris.isEmpty())
+		{
+			prewarmEngines();
+
+			// idle connections are eventually closed, so open them again
+			if(prewarmInterval > 0)
+			{
+				prewarmTimer = new QTimer(this);
+				connect(prewarmTimer, &QTimer::timeout, this, &Private::prewarmTimer_timeout);
+				prewarmTimer->start(prewarmInterval * 1000);
+			}
 		}
 
 		if(in_valve)
 			in_valve->open();
+		if(in_stream_valve)
+			in_stream_valve->open();
 		if(in_req_valve)
 			in_req_valve->open();
 
 		log_info("started");
 	}
 
-	bool bindSpec(QZmq::Socket *sock, const QString &specName, const QString &specValue, int ipcFileMode)
+	void startEngines()
+	{
+		qRegisterMetaType<Worker::Format>();
+		qRegisterMetaType<QList<QByteArray> >();
+		qRegisterMetaType<ZhttpResponsePacket>();
+
+		// with a single engine, everything runs on the main thread as
+		//   before. otherwise each engine gets its own thread, and with
+		//   it its own curl connection manager and timers
+		for(int n = 0; n < config.engineThreads; ++n)
+		{
+			Engine *e = new Engine(&config);
+			connect(e, &Engine::readyRead, this, &Private::engine_readyRead);
+			connect(e, &Engine::sessionNotFound, this, &Private::engine_sessionNotFound);
+			connect(e, &Engine::workerFinished, this, &Private::engine_workerFinished);
+
+			if(config.engineThreads > 1)
+			{
+				QThread *thread = new QThread(this);
+				thread->setObjectName(QString("engine-%1").arg(n));
+				e->moveToThread(thread);
+				connect(thread, &QThread::finished, e, &QObject::deleteLater);
+				engineThreads += thread;
+				thread->start();
+			}
+			else
+			{
+				e->setParent(this);
+			}
+
+			engines += e;
+		}
+
+		if(config.engineThreads > 1)
+			log_info("using %d engine threads", config.engineThreads);
+	}
+
+	void stopEngines()
+	{
+		// engines on threads delete themselves as the threads finish
+		foreach(QThread *thread, engineThreads)
+		{
+			thread->quit();
+			thread->wait();
+		}
+
+		qDeleteAll(engineThreads);
+		engineThreads.clear();
+		engines.clear();
+	}
+
+	Engine *engineForRid(const QByteArray &rid)
+	{
+		if(engines.count() == 1)
+			return engines.first();
+
+		// sessions without an id have nothing to follow, so spread them
+		if(rid.isEmpty())
+		{
+			nextEngine = (nextEngine + 1) % engines.count();
+			return engines[nextEngine];
+		}
+
+		return engines[qHash(rid) % engines.count()];
+	}
+
+	void engineStart(Engine *e, Worker::Format format, const QByteArray &rid, int seq, const ZhttpRequestPacket &request, Worker::Mode mode, const QList<QByteArray> &reqHeaders, const ZhttpCodec::RequestExtras &extras)
+	{
+		if(engineThreads.isEmpty())
+		{
+			e->start(format, rid, seq, request, mode, reqHeaders, extras);
+			return;
+		}
+
+		QMetaObject::invokeMethod(e, [=]() {
+			e->start(format, rid, seq, request, mode, reqHeaders, extras);
+		}, Qt::QueuedConnection);
+	}
+
+	// each engine thread has its own connection pool, so all of them
+	//   get the connections
+	void prewarmEngines()
+	{
+		QList<QUrl> uris = prewarmUris;
+		int count = prewarmCount;
+
+		foreach(Engine *e, engines)
+		{
+			if(engineThreads.isEmpty())
+			{
+				e->prewarm(uris, count);
+				continue;
+			}
+
+			QMetaObject::invokeMethod(e, [=]() {
+				e->prewarm(uris, count);
+			}, Qt::QueuedConnection);
+		}
+	}
+
+	void engineWrite(Engine *e, const QByteArray &rid, int seq, const ZhttpRequestPacket &request)
+	{
+		if(engineThreads.isEmpty())
+		{
+			e->write(rid, seq, request);
+			return;
+		}
+
+		QMetaObject::invokeMethod(e, [=]() {
+			e->write(rid, seq, request);
+		}, Qt::QueuedConnection);
+	}
+
+	// works with QZmq::Socket and ZmqPublisher
+	template <typename T>
+	bool bindSpec(T *sock, const QString &specName, const QString &specValue, int ipcFileMode)
 	{
 		if(!sock->bind(specValue))
 		{
@@ -480,29 +642,40 @@ public:
 		return true;
 	}
 
-	void handleIncoming(InputType type, const QByteArray &message, const QList<QByteArray> &reqHeaders = QList<QByteArray>())
+	static QByteArray encodeVariant(Worker::Format format, const QVariant &vresponse)
 	{
-		if(message.length() < 1)
-		{
-			log_warning("received message with invalid format (empty), skipping");
-			return;
-		}
-
-		Worker::Format format;
-		if(message[0] == 'T')
+		if(format == Worker::TnetStringFormat)
 		{
-			format = Worker::TnetStringFormat;
+			return QByteArray("T") + TnetString::fromVariant(vresponse);
 		}
-		else if(message[0] == 'J')
+		else // JsonFormat
 		{
-			format = Worker::JsonFormat;
+			QVariant data = ZhttpCodec::convertToJsonStyle(vresponse);
+			QJsonDocument doc;
+			if(data.type() == QVariant::Map)
+				doc = QJsonDocument(QJsonObject::fromVariantMap(data.toMap()));
+			else if(data.type() == QVariant::List)
+				doc = QJsonDocument(QJsonArray::fromVariantList(data.toList()));
+			return QByteArray("J") + doc.toJson(QJsonDocument::Compact);
 		}
-		else
+	}
+
+	// for comparing encodings, which may differ in field order
+	static QVariant parseEncoded(const QByteArray &part)
+	{
+		if(part.startsWith('T'))
 		{
-			log_warning("received message with invalid format (unsupported type), skipping");
-			return;
+			bool ok;
+			return TnetString::toVariant(part, 1, &ok);
 		}
 
+		QJsonDocument doc = QJsonDocument::fromJson(part.mid(1));
+		return ZhttpCodec::convertFromJsonStyle(doc.object().toVariantMap());
+	}
+
+	// returns false if the message should be skipped
+	bool decodeVariant(InputType type, Worker::Format format, const QByteArray &message, ZhttpRequestPacket *p, ZhttpCodec::RequestExtras *extras = 0)
+	{
 		QVariant data;
 		if(format == Worker::TnetStringFormat)
 		{
@@ -511,7 +684,7 @@ public:
 			if(!ok)
 			{
 				log_warning("received message with invalid format (tnetstring parse failed), skipping");
-				return;
+				return false;
 			}
 		}
 		else // JsonFormat
@@ -521,7 +694,7 @@ public:
 			if(e.error != QJsonParseError::NoError)
 			{
 				log_warning("received message with invalid format (json parse failed), skipping");
-				return;
+				return false;
 			}
 
 			if(doc.isObject())
@@ -529,7 +702,7 @@ public:
 			else if(doc.isArray())
 				data = doc.array().toVariantList();
 
-			data = convertFromJsonStyle(data);
+			data = ZhttpCodec::convertFromJsonStyle(data);
 		}
 
 		if(log_outputLevel() >= LOG_LEVEL_DEBUG)
@@ -542,55 +715,106 @@ public:
 				log_debug("recv-req: %s", qPrintable(TnetString::variantToString(data, -1)));
 		}
 
-		ZhttpRequestPacket p;
-		if(!p.fromVariant(data))
+		if(!p->fromVariant(data))
 		{
 			log_warning("received message with invalid format (parse failed), skipping");
 
-			if((p.type != ZhttpRequestPacket::Error && p.type != ZhttpRequestPacket::Cancel) && !p.from.isEmpty() && !p.ids.isEmpty())
+			if((p->type != ZhttpRequestPacket::Error && p->type != ZhttpRequestPacket::Cancel) && !p->from.isEmpty() && !p->ids.isEmpty())
 			{
-				respondError(p.from, p.ids.first().id, "bad-request");
+				respondError(p->from, p->ids.first().id, "bad-request");
 			}
 
+			return false;
+		}
+
+		if(extras)
+			*extras = ZhttpCodec::requestExtrasFromVariant(data);
+
+		return true;
+	}
+
+	void handleIncoming(InputType type, const QByteArray &message, const QList<QByteArray> &reqHeaders = QList<QByteArray>())
+	{
+		if(message.length() < 1)
+		{
+			log_warning("received message with invalid format (empty), skipping");
 			return;
 		}
 
-		if(type == InStream)
+		Worker::Format format;
+		if(message[0] == 'T')
 		{
-			if(p.ids.isEmpty())
-			{
-				log_warning("received stream message without request id, skipping");
-				return;
-			}
+			format = Worker::TnetStringFormat;
+		}
+		else if(message[0] == 'J')
+		{
+			format = Worker::JsonFormat;
+		}
+		else
+		{
+			log_warning("received message with invalid format (unsupported type), skipping");
+			return;
+		}
 
-			foreach(const ZhttpRequestPacket::Id &id, p.ids)
+		ZhttpRequestPacket p;
+		ZhttpCodec::RequestExtras extras;
+		bool decoded = false;
+
+		// the direct decoder can't log the message, so it is only used
+		//   below debug level
+		if(directCodec && log_outputLevel() < LOG_LEVEL_DEBUG)
+		{
+			decoded = ZhttpCodec::parseRequest(message, &p, &extras);
+
+			// decode again the old way and compare. the variant result
+			//   wins, so behavior is unchanged while validating
+			if(decoded && validateCodec)
 			{
-				Worker *w = streamWorkersByRid.value(id.id);
-				if(!w)
+				ZhttpRequestPacket vp;
+				ZhttpCodec::RequestExtras vextras;
+				if(!decodeVariant(type, format, message, &vp, &vextras))
 				{
-					if((p.type != ZhttpRequestPacket::Error && p.type != ZhttpRequestPacket::Cancel) && !p.from.isEmpty() && !p.ids.isEmpty())
-					{
-						respondCancel(p.from, id.id);
-					}
+					log_warning("direct decode mismatch: variant path rejected message");
+					return;
+				}
 
-					continue;
+				if(vp.toVariant() != p.toVariant())
+				{
+					log_warning("direct decode mismatch: %s", qPrintable(TnetString::variantToString(vp.toVariant(), -1)));
+					p = vp;
 				}
 
-				w->write(id.seq, p);
+				if(vextras != extras)
+				{
+					log_warning("direct decode mismatch: request extras");
+					extras = vextras;
+				}
 			}
+		}
 
+		// anything the direct decoder doesn't handle, including malformed
+		//   input, goes through the variant path so errors are reported
+		//   the same way
+		if(!decoded && !decodeVariant(type, format, message, &p, &extras))
 			return;
-		}
 
-		if(p.ids.count() > 1)
+		if(type == InStream)
 		{
-			log_warning("received initial message with multiple ids, skipping");
+			if(p.ids.isEmpty())
+			{
+				log_warning("received stream message without request id, skipping");
+				return;
+			}
+
+			foreach(const ZhttpRequestPacket::Id &id, p.ids)
+				engineWrite(engineForRid(id.id), id.id, id.seq, p);
+
 			return;
 		}
 
-		if(!p.ids.isEmpty() && streamWorkersByRid.contains(p.ids.first().id))
+		if(p.ids.count() > 1)
 		{
-			log_warning("received request for id already in use, skipping");
+			log_warning("received initial message with multiple ids, skipping");
 			return;
 		}
 
@@ -602,19 +826,13 @@ public:
 			seq = p.ids.first().seq;
 		}
 
-		Worker *w = new Worker(&config, format, this);
-		connect(w, &Worker::readyRead, this, &Private::worker_readyRead);
-		connect(w, &Worker::finished, this, &Private::worker_finished);
+		++workerCount;
 
-		workers += w;
-
-		if(type == InInit && !rid.isEmpty())
-			streamWorkersByRid[rid] = w;
-		else if(type == InReq)
-			reqHeadersByWorker[w] = reqHeaders;
-
-		if(config.maxWorkers != -1 && workers.count() >= config.maxWorkers)
+		if(config.maxWorkers != -1 && workerCount >= config.maxWorkers)
 		{
+			if(!valveClosedTime.isValid())
+				valveClosedTime.start();
+
 			if(in_valve)
 				in_valve->close();
 
@@ -622,7 +840,7 @@ public:
 				in_req_valve->close();
 		}
 
-		w->start(rid, seq, p, (type == InInit ? Worker::Stream : Worker::Single));
+		engineStart(engineForRid(rid), format, rid, seq, p, (type == InInit ? Worker::Stream : Worker::Single), reqHeaders, extras);
 	}
 
 	// normally responses are handled by Workers, but in some routing
@@ -633,8 +851,7 @@ public:
 		ZhttpResponsePacket out;
 		out.ids += ZhttpResponsePacket::Id(rid);
 		out.type = ZhttpResponsePacket::Cancel;
-		QByteArray part = QByteArray("T") + TnetString::fromVariant(out.toVariant());
-		out_sock->write(QList<QByteArray>() << (receiver + ' ' + part));
+		out_sock->write(ZhttpCodec::serializeResponse(out, 'T', receiver));
 	}
 
 	void respondError(const QByteArray &receiver, const QByteArray &rid, const QByteArray &condition)
@@ -643,8 +860,7 @@ public:
 		out.ids += ZhttpResponsePacket::Id(rid);
 		out.type = ZhttpResponsePacket::Error;
 		out.condition = condition;
-		QByteArray part = QByteArray("T") + TnetString::fromVariant(out.toVariant());
-		out_sock->write(QList<QByteArray>() << (receiver + ' ' + part));
+		out_sock->write(ZhttpCodec::serializeResponse(out, 'T', receiver));
 	}
 
 private slots:
@@ -659,10 +875,9 @@ private slots:
 		handleIncoming(InInit, message[0]);
 	}
 
-	void in_stream_readyRead()
+	void in_stream_readyRead(const QList<QByteArray> &message)
 	{
 		// message from DEALER socket will have two parts, with first part empty
-		QList<QByteArray> message = in_stream_sock->read();
 		if(message.count() != 2)
 		{
 			log_warning("received message with parts != 2, skipping");
@@ -690,57 +905,73 @@ private slots:
 		handleIncoming(InReq, reqMessage.content()[0], reqMessage.headers());
 	}
 
-	void worker_readyRead(const QByteArray &receiver, const ZhttpResponsePacket &response)
+	void engine_readyRead(Worker::Format format, const QByteArray &receiver, const QList<QByteArray> &reqHeaders, const ZhttpResponsePacket &response)
 	{
-		Worker *w = (Worker *)sender();
-
-		QVariant vresponse = response.toVariant();
+		char formatChar = (format == Worker::TnetStringFormat ? 'T' : 'J');
 
-		QByteArray part;
-		Worker::Format format = w->format();
-		if(format == Worker::TnetStringFormat)
+		// as with decoding, the direct encoder is skipped at debug level
+		//   since the variant is needed for logging anyway
+		QByteArray buf;
+		if(directCodec && log_outputLevel() < LOG_LEVEL_DEBUG)
 		{
-			part = QByteArray("T") + TnetString::fromVariant(vresponse);
-		}
-		else // JsonFormat
-		{
-			QVariant data = convertToJsonStyle(vresponse);
-			QJsonDocument doc;
-			if(data.type() == QVariant::Map)
-				doc = QJsonDocument(QJsonObject::fromVariantMap(data.toMap()));
-			else if(data.type() == QVariant::List)
-				doc = QJsonDocument(QJsonArray::fromVariantList(data.toList()));
-			part = QByteArray("J") + doc.toJson(QJsonDocument::Compact);
+			buf = ZhttpCodec::serializeResponse(response, formatChar, receiver);
+
+			if(!buf.isEmpty() && validateCodec)
+			{
+				int prefixSize = (!receiver.isEmpty() ? receiver.size() + 1 : 0);
+				QVariant direct = parseEncoded(buf.mid(prefixSize));
+				QVariant expected = parseEncoded(encodeVariant(format, response.toVariant()));
+				if(direct != expected)
+					log_warning("direct encode mismatch: %s", qPrintable(TnetString::variantToString(expected, -1)));
+			}
 		}
 
 		if(!receiver.isEmpty())
 		{
-			if(log_outputLevel() >= LOG_LEVEL_DEBUG)
-				log_debug("send: %s", qPrintable(TnetString::variantToString(vresponse, -1)));
+			if(buf.isEmpty())
+			{
+				QVariant vresponse = response.toVariant();
 
-			out_sock->write(QList<QByteArray>() << (receiver + ' ' + part));
+				if(log_outputLevel() >= LOG_LEVEL_DEBUG)
+					log_debug("send: %s", qPrintable(TnetString::variantToString(vresponse, -1)));
+
+				buf = receiver + ' ' + encodeVariant(format, vresponse);
+			}
+
+			out_sock->write(buf);
 		}
 		else
 		{
-			if(log_outputLevel() >= LOG_LEVEL_DEBUG)
-				log_debug("send-req: %s", qPrintable(TnetString::variantToString(vresponse, -1)));
+			if(buf.isEmpty())
+			{
+				QVariant vresponse = response.toVariant();
 
-			assert(reqHeadersByWorker.contains(w));
-			QList<QByteArray> reqHeaders = reqHeadersByWorker.value(w);
-			in_req_sock->write(QZmq::ReqMessage(reqHeaders, QList<QByteArray>() << part).toRawMessage());
+				if(log_outputLevel() >= LOG_LEVEL_DEBUG)
+					log_debug("send-req: %s", qPrintable(TnetString::variantToString(vresponse, -1)));
+
+				buf = encodeVariant(format, vresponse);
+			}
+
+			assert(!reqHeaders.isEmpty());
+			in_req_sock->write(QZmq::ReqMessage(reqHeaders, QList<QByteArray>() << buf).toRawMessage());
 		}
 	}
 
-	void worker_finished()
+	void engine_sessionNotFound(const QByteArray &receiver, const QByteArray &rid)
 	{
-		Worker *w = (Worker *)sender();
+		respondCancel(receiver, rid);
+	}
 
-		if(!w->rid().isEmpty())
-			streamWorkersByRid.remove(w->rid());
-		reqHeadersByWorker.remove(w);
-		workers.remove(w);
+	void engine_workerFinished()
+	{
+		assert(workerCount > 0);
+		--workerCount;
 
-		delete w;
+		if(valveClosedTime.isValid())
+		{
+			Stats::add(Stats::ValveClosedMsecs, valveClosedTime.elapsed());
+			valveClosedTime.invalidate();
+		}
 
 		// ensure the valves are open
 		if(in_valve)
@@ -749,6 +980,24 @@ private slots:
 			in_req_valve->open();
 	}
 
+	void statsTimer_timeout()
+	{
+		// count time spent closed so far, so long stalls show up while
+		//   they are happening
+		if(valveClosedTime.isValid())
+			Stats::add(Stats::ValveClosedMsecs, valveClosedTime.restart());
+
+		QVariantHash vstats = Stats::snapshot().toHash();
+		vstats["from"] = config.clientId;
+
+		stats_sock->write("stats T" + TnetString::fromVariant(vstats));
+	}
+
+	void prewarmTimer_timeout()
+	{
+		prewarmEngines();
+	}
+
 	void reload()
 	{
 		log_info("reloading");
@@ -762,6 +1011,9 @@ private slots:
 		// remove the handler, so if we get another signal then we crash out
 		ProcessQuit::cleanup();
 
+		stopEngines();
+		accesslog_stop();
+
 		log_info("stopped");
 		emit q->quit();
 	}
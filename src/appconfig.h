@@ -31,6 +31,7 @@
 
 #include <QString>
 #include <QStringList>
+#include "accesspolicy.h"
 
 class AppConfig
 {
@@ -38,11 +39,19 @@ public:
 	QByteArray clientId;
 	QString defaultPolicy;
 	QStringList allowExps, denyExps;
+	AccessPolicy accessPolicy; // compiled from the above
 	bool allowIPv6;
 	int maxWorkers;
+	int maxHostRequests;
+	int maxHostQueue;
 	int sessionBufferSize;
 	int activityTimeout;
 	int persistentConnectionMaxTime;
+	int engineThreads;
+	int coalesceInterval;
+	int flushSize;
+	int flushDelay;
+	bool http2;
 };
 
 #endif
@@ -0,0 +1,163 @@
+/*
+ * Copyright (C) 2026 Fanout, Inc.
+ *
+ * This file is part of Zurl.
+ *
+ * $FANOUT_BEGIN_LICENSE:GPL$
+ *
+ * Zurl is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zurl is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Zurl may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#include "batchvalve.h"
+
+#include <QPointer>
+#include "qzmqsocket.h"
+
+#define DEFAULT_BATCH_SIZE 100
+
+class BatchValve::Private : public QObject
+{
+	Q_OBJECT
+
+public:
+	BatchValve *q;
+	QZmq::Socket *sock;
+	bool isOpen;
+	bool pendingRead;
+	int batchSize;
+	int batchesCounter;
+	int messagesCounter;
+
+	Private(QZmq::Socket *_sock, BatchValve *_q) :
+		QObject(_q),
+		q(_q),
+		sock(_sock),
+		isOpen(false),
+		pendingRead(false),
+		batchSize(DEFAULT_BATCH_SIZE),
+		batchesCounter(-1),
+		messagesCounter(-1)
+	{
+		connect(sock, &QZmq::Socket::readyRead, this, &Private::sock_readyRead);
+	}
+
+	void queueRead()
+	{
+		if(pendingRead)
+			return;
+
+		pendingRead = true;
+		QMetaObject::invokeMethod(this, "doRead", Qt::QueuedConnection);
+	}
+
+	void tryRead()
+	{
+		QPointer<QObject> self = this;
+
+		int count = 0;
+		while(isOpen && sock->canRead())
+		{
+			if(count >= batchSize)
+			{
+				// more to read, but let other events through first
+				queueRead();
+				break;
+			}
+
+			QList<QByteArray> msg = sock->read();
+			++count;
+
+			if(!msg.isEmpty())
+			{
+				emit q->readyRead(msg);
+				if(!self)
+					return;
+			}
+		}
+
+		if(count > 0 && batchesCounter != -1)
+		{
+			Stats::add((Stats::Counter)batchesCounter);
+			Stats::add((Stats::Counter)messagesCounter, count);
+		}
+	}
+
+private slots:
+	void sock_readyRead()
+	{
+		if(pendingRead)
+			return;
+
+		tryRead();
+	}
+
+	void doRead()
+	{
+		pendingRead = false;
+
+		tryRead();
+	}
+};
+
+BatchValve::BatchValve(QZmq::Socket *sock, QObject *parent) :
+	QObject(parent)
+{
+	d = new Private(sock, this);
+}
+
+BatchValve::~BatchValve()
+{
+	delete d;
+}
+
+bool BatchValve::isOpen() const
+{
+	return d->isOpen;
+}
+
+void BatchValve::setBatchSize(int size)
+{
+	d->batchSize = qMax(size, 1);
+}
+
+void BatchValve::open()
+{
+	if(d->isOpen)
+		return;
+
+	d->isOpen = true;
+
+	// messages may have arrived while closed
+	d->queueRead();
+}
+
+void BatchValve::close()
+{
+	d->isOpen = false;
+}
+
+void BatchValve::setStatsCounters(Stats::Counter batches, Stats::Counter messages)
+{
+	d->batchesCounter = batches;
+	d->messagesCounter = messages;
+}
+
+#include "batchvalve.moc"
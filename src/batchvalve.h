@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2026 Fanout, Inc.
+ *
+ * This file is part of Zurl.
+ *
+ * $FANOUT_BEGIN_LICENSE:GPL$
+ *
+ * Zurl is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zurl is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Zurl may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#ifndef BATCHVALVE_H
+#define BATCHVALVE_H
+
+#include <QObject>
+#include "stats.h"
+
+namespace QZmq {
+class Socket;
+}
+
+// like QZmq::Valve, but reads up to a fixed number of messages per event
+//   loop turn, then yields and continues in a later turn. this keeps busy
+//   sockets from starving other event sources while still avoiding a
+//   round trip through the event loop for every message
+
+class BatchValve : public QObject
+{
+	Q_OBJECT
+
+public:
+	BatchValve(QZmq::Socket *sock, QObject *parent = 0);
+	~BatchValve();
+
+	bool isOpen() const;
+
+	void setBatchSize(int size);
+
+	void open();
+	void close();
+
+	// counters to add to for each non-empty batch and each message read
+	void setStatsCounters(Stats::Counter batches, Stats::Counter messages);
+
+signals:
+	void readyRead(const QList<QByteArray> &message);
+
+private:
+	class Private;
+	friend class Private;
+	Private *d;
+};
+
+#endif
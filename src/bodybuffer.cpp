@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) 2026 Fanout, Inc.
+ *
+ * This file is part of Zurl.
+ *
+ * $FANOUT_BEGIN_LICENSE:GPL$
+ *
+ * Zurl is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zurl is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Zurl may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#include "bodybuffer.h"
+
+#include <string.h>
+
+BodyBuffer::BodyBuffer() :
+	size_(0),
+	pos_(0),
+	index_(0),
+	offset_(0),
+	retain_(true)
+{
+}
+
+void BodyBuffer::setRetaining(bool on)
+{
+	if(!on && retain_)
+	{
+		retain_ = false;
+		dropRead();
+	}
+}
+
+void BodyBuffer::append(const QByteArray &buf)
+{
+	if(buf.isEmpty())
+		return;
+
+	segments_ += buf;
+	size_ += buf.size();
+}
+
+int BodyBuffer::read(char *dest, int max)
+{
+	int total = 0;
+	while(max > 0 && index_ < segments_.count())
+	{
+		const QByteArray &seg = segments_[index_];
+		int n = qMin(max, seg.size() - offset_);
+		memcpy(dest, seg.constData() + offset_, n);
+		dest += n;
+		max -= n;
+		total += n;
+		offset_ += n;
+
+		if(offset_ >= seg.size())
+		{
+			++index_;
+			offset_ = 0;
+		}
+	}
+
+	pos_ += total;
+
+	if(!retain_)
+		dropRead();
+
+	return total;
+}
+
+bool BodyBuffer::seek(int pos)
+{
+	if(!retain_ || pos < 0 || pos > size_)
+		return false;
+
+	// rewinds are rare, so a walk from the start is fine
+	index_ = 0;
+	offset_ = pos;
+	while(index_ < segments_.count() && offset_ >= segments_[index_].size())
+	{
+		offset_ -= segments_[index_].size();
+		++index_;
+	}
+
+	pos_ = pos;
+	return true;
+}
+
+void BodyBuffer::clear()
+{
+	segments_.clear();
+	size_ = 0;
+	pos_ = 0;
+	index_ = 0;
+	offset_ = 0;
+}
+
+void BodyBuffer::dropRead()
+{
+	// a partially read segment stays, with the read part counted in
+	//   size_ and pos_, rather than being copied to trim it
+	for(int n = 0; n < index_; ++n)
+	{
+		int segSize = segments_.first().size();
+		size_ -= segSize;
+		pos_ -= segSize;
+		segments_.removeFirst();
+	}
+
+	index_ = 0;
+}
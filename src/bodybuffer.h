@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2026 Fanout, Inc.
+ *
+ * This file is part of Zurl.
+ *
+ * $FANOUT_BEGIN_LICENSE:GPL$
+ *
+ * Zurl is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zurl is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Zurl may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#ifndef BODYBUFFER_H
+#define BODYBUFFER_H
+
+#include <QByteArray>
+#include <QList>
+
+// request body store for uploads. appended arrays are kept as-is, and
+//   reads copy straight from them into the destination. while retaining,
+//   data that has been read is kept so the read position can be moved
+//   back, for example when curl rewinds to resend a body
+
+class BodyBuffer
+{
+public:
+	BodyBuffer();
+
+	bool isRetaining() const { return retain_; }
+
+	// turning retention off releases everything before the read position.
+	//   it can't be turned back on
+	void setRetaining(bool on);
+
+	// bytes held, including any already read and still retained
+	int size() const { return size_; }
+
+	int bytesAvailable() const { return size_ - pos_; }
+
+	void append(const QByteArray &buf);
+
+	// copies up to max bytes into dest. returns the number copied
+	int read(char *dest, int max);
+
+	// only possible while retaining. pos is relative to the start
+	bool seek(int pos);
+
+	void clear();
+
+private:
+	QList<QByteArray> segments_;
+	int size_;
+	int pos_;
+	int index_; // segment containing the read position
+	int offset_; // read position within that segment
+	bool retain_;
+
+	void dropRead();
+};
+
+#endif
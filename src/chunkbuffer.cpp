@@ -0,0 +1,257 @@
+/*
+ * Copyright (C) 2026 Fanout, Inc.
+ *
+ * This file is part of Zurl.
+ *
+ * $FANOUT_BEGIN_LICENSE:GPL$
+ *
+ * Zurl is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zurl is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Zurl may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#include "chunkbuffer.h"
+
+#include <string.h>
+#include <atomic>
+#include <QVector>
+#include "stats.h"
+
+#define POOL_MAX 256
+
+// lent chunks are checked for release once there are this many, or twice
+//   as many as were still referenced at the last check
+#define LENT_SCAN_MIN 64
+
+static qint64 g_memoryBudget = 0; // 0 for no limit
+static std::atomic<qint64> g_memoryReserved(0);
+
+// chunks that were fully read by copying, and whose memory nobody else
+//   references, are kept for reuse. each is charged to the budget, and
+//   chunks are only pooled while the budget has room
+static thread_local QVector<QByteArray> t_pool;
+
+// chunks handed out by take(), each charged to the budget until the
+//   receiver drops its reference
+static thread_local QVector<QByteArray> t_lent;
+static thread_local int t_lentScanAt = LENT_SCAN_MIN;
+
+static void freeChunk(QByteArray &chunk)
+{
+	if(chunk.isDetached() && chunk.capacity() == ChunkBuffer::ChunkSize && t_pool.count() < POOL_MAX && ChunkBuffer::reserveMemory(ChunkBuffer::ChunkSize))
+		t_pool += chunk;
+
+	chunk.clear();
+}
+
+// returns lent chunks no longer referenced elsewhere. the scan is
+//   deferred until the list has grown enough to pay for it, so the cost
+//   per allocation stays constant however many chunks are outstanding
+static void reclaimLent()
+{
+	if(t_lent.count() < t_lentScanAt)
+		return;
+
+	int kept = 0;
+	for(int n = 0; n < t_lent.count(); ++n)
+	{
+		if(t_lent[n].isDetached())
+		{
+			QByteArray chunk = t_lent[n];
+			ChunkBuffer::releaseMemory(ChunkBuffer::ChunkSize);
+			freeChunk(chunk);
+		}
+		else
+		{
+			if(kept != n)
+				t_lent[kept] = t_lent[n];
+			++kept;
+		}
+	}
+
+	t_lent.resize(kept);
+	t_lentScanAt = qMax(kept * 2, LENT_SCAN_MIN);
+}
+
+static QByteArray allocChunk()
+{
+	reclaimLent();
+
+	if(!t_pool.isEmpty())
+	{
+		QByteArray chunk = t_pool.takeLast();
+		ChunkBuffer::releaseMemory(ChunkBuffer::ChunkSize);
+		chunk.resize(0);
+		return chunk;
+	}
+
+	QByteArray chunk;
+	chunk.reserve(ChunkBuffer::ChunkSize);
+	return chunk;
+}
+
+static void lendChunk(const QByteArray &chunk)
+{
+	reclaimLent();
+
+	// already allocated, so it can't be refused
+	ChunkBuffer::reserveMemory(ChunkBuffer::ChunkSize, true);
+	t_lent += chunk;
+}
+
+ChunkBuffer::ChunkBuffer() :
+	offset_(0),
+	size_(0)
+{
+}
+
+ChunkBuffer::~ChunkBuffer()
+{
+	clear();
+}
+
+void ChunkBuffer::append(const char *data, int size)
+{
+	while(size > 0)
+	{
+		if(chunks_.isEmpty() || chunks_.last().size() >= ChunkSize)
+			chunks_ += allocChunk();
+
+		QByteArray &last = chunks_.last();
+		int n = qMin(size, ChunkSize - last.size());
+
+		// within the reserved capacity, so this doesn't allocate
+		last.append(data, n);
+
+		data += n;
+		size -= n;
+		size_ += n;
+	}
+}
+
+QByteArray ChunkBuffer::take(int size)
+{
+	if(size < 0 || size > size_)
+		size = size_;
+
+	if(size == 0)
+		return QByteArray();
+
+	const QByteArray &first = chunks_.first();
+
+	// hand off the first chunk as-is. the buffer drops its reference, so
+	//   it won't be appended to again
+	if(offset_ == 0 && first.size() <= size && first.size() >= ChunkSize / 2)
+	{
+		QByteArray out = first;
+		chunks_.removeFirst();
+		size_ -= out.size();
+
+		if(out.capacity() == ChunkSize)
+			lendChunk(out);
+
+		Stats::add(Stats::BodyBytesShared, out.size());
+		return out;
+	}
+
+	QByteArray out(size, Qt::Uninitialized);
+	char *p = out.data();
+	int left = size;
+	while(left > 0)
+	{
+		const QByteArray &chunk = chunks_.first();
+		int n = qMin(left, chunk.size() - offset_);
+		memcpy(p, chunk.data() + offset_, n);
+		p += n;
+		left -= n;
+		offset_ += n;
+
+		if(offset_ >= chunk.size())
+			removeFirst();
+	}
+
+	size_ -= size;
+
+	Stats::add(Stats::BodyBytesCopied, size);
+	return out;
+}
+
+int ChunkBuffer::spare() const
+{
+	return (chunks_.isEmpty() ? 0 : ChunkSize - chunks_.last().size());
+}
+
+int ChunkBuffer::capacityAfter(int size) const
+{
+	int n = spare();
+	return capacity() + (size > n ? alignToChunks(size - n) : 0);
+}
+
+void ChunkBuffer::clear()
+{
+	while(!chunks_.isEmpty())
+		removeFirst();
+
+	size_ = 0;
+}
+
+void ChunkBuffer::removeFirst()
+{
+	QByteArray chunk = chunks_.takeFirst();
+	offset_ = 0;
+	freeChunk(chunk);
+}
+
+int ChunkBuffer::alignToChunks(int size)
+{
+	return ((size + ChunkSize - 1) / ChunkSize) * ChunkSize;
+}
+
+void ChunkBuffer::setMemoryBudget(qint64 bytes)
+{
+	g_memoryBudget = bytes;
+}
+
+bool ChunkBuffer::reserveMemory(qint64 size, bool force)
+{
+	if(g_memoryBudget <= 0 || force)
+	{
+		g_memoryReserved.fetch_add(size);
+		return true;
+	}
+
+	qint64 cur = g_memoryReserved.load();
+	do
+	{
+		if(cur + size > g_memoryBudget)
+			return false;
+	} while(!g_memoryReserved.compare_exchange_weak(cur, cur + size));
+
+	return true;
+}
+
+void ChunkBuffer::releaseMemory(qint64 size)
+{
+	g_memoryReserved.fetch_sub(size);
+}
+
+qint64 ChunkBuffer::memoryReserved()
+{
+	return g_memoryReserved.load();
+}
@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2026 Fanout, Inc.
+ *
+ * This file is part of Zurl.
+ *
+ * $FANOUT_BEGIN_LICENSE:GPL$
+ *
+ * Zurl is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zurl is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Zurl may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#ifndef CHUNKBUFFER_H
+#define CHUNKBUFFER_H
+
+#include <QByteArray>
+#include <QList>
+
+// byte queue made of fixed-size chunks, taken from a per-thread pool.
+//   appending copies into the last chunk without allocating, and take()
+//   hands out a whole chunk by reference when it can, rather than copying.
+//   not thread safe, and chunks must be freed on the thread that
+//   allocated them for pooling to be effective.
+//
+// chunk memory counts against a budget shared by all threads. owners of
+//   buffers reserve their capacity in whole chunks. pooled chunks, and
+//   chunks handed out by take() that are still referenced elsewhere, are
+//   charged by the buffer code itself
+
+class ChunkBuffer
+{
+public:
+	enum { ChunkSize = 32768 };
+
+	ChunkBuffer();
+	~ChunkBuffer();
+
+	int size() const { return size_; }
+	bool isEmpty() const { return size_ == 0; }
+
+	// bytes of chunk memory held, including read and unused parts
+	int capacity() const { return chunks_.count() * ChunkSize; }
+
+	// bytes that can be appended without taking another chunk
+	int spare() const;
+
+	// capacity that appending size bytes would bring the buffer to
+	int capacityAfter(int size) const;
+
+	void append(const char *data, int size);
+
+	// returns at most size bytes, or everything if size is -1. if the
+	//   first chunk fits and is unread and at least half full, only it is
+	//   returned, without copying. the caller should call again if it
+	//   wants more
+	QByteArray take(int size = -1);
+
+	void clear();
+
+	// rounds up to whole chunks
+	static int alignToChunks(int size);
+
+	// 0 (default) for no limit
+	static void setMemoryBudget(qint64 bytes);
+
+	// if force is set, the reservation is made even if it goes over the
+	//   budget
+	static bool reserveMemory(qint64 size, bool force = false);
+	static void releaseMemory(qint64 size);
+	static qint64 memoryReserved();
+
+private:
+	QList<QByteArray> chunks_;
+	int offset_; // read position in the first chunk
+	int size_;
+
+	void removeFirst();
+};
+
+#endif
@@ -0,0 +1,160 @@
+/*
+ * Copyright (C) 2026 Fanout, Inc.
+ *
+ * This file is part of Zurl.
+ *
+ * $FANOUT_BEGIN_LICENSE:GPL$
+ *
+ * Zurl is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zurl is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Zurl may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#include "connectionwarmer.h"
+
+#include <QHash>
+#include <QUrl>
+#include <QElapsedTimer>
+#include "httprequest.h"
+#include "logutil.h"
+
+class ConnectionWarmer::Private : public QObject
+{
+	Q_OBJECT
+
+public:
+	class Item
+	{
+	public:
+		QUrl uri;
+		QElapsedTimer time;
+	};
+
+	ConnectionWarmer *q;
+	bool allowIPv6;
+	QHash<HttpRequest*, Item> items;
+
+	Private(ConnectionWarmer *_q) :
+		QObject(_q),
+		q(_q),
+		allowIPv6(false)
+	{
+	}
+
+	~Private()
+	{
+		qDeleteAll(items.keys());
+	}
+
+	bool inProgress(const QUrl &uri) const
+	{
+		foreach(const Item &i, items)
+		{
+			if(i.uri == uri)
+				return true;
+		}
+
+		return false;
+	}
+
+	void start(const QList<QUrl> &uris, int count)
+	{
+		foreach(const QUrl &uri, uris)
+		{
+			if(inProgress(uri))
+				continue;
+
+			// requests started together can't share a connection, so
+			//   each one opens its own
+			for(int n = 0; n < count; ++n)
+			{
+				HttpRequest *req = new HttpRequest(this);
+				connect(req, &HttpRequest::readyRead, this, &Private::req_readyRead);
+				connect(req, &HttpRequest::error, this, &Private::req_error);
+
+				req->setAllowIPv6(allowIPv6);
+
+				Item i;
+				i.uri = uri;
+				i.time.start();
+				items.insert(req, i);
+
+				req->start("HEAD", uri, HttpHeaders(), false);
+			}
+		}
+	}
+
+	// emits signals, but safe to delete after
+	void finish(HttpRequest *req)
+	{
+		items.remove(req);
+		req->disconnect(this);
+		req->setParent(0);
+		req->deleteLater();
+
+		if(items.isEmpty())
+			emit q->finished();
+	}
+
+private slots:
+	void req_readyRead()
+	{
+		HttpRequest *req = (HttpRequest *)sender();
+		req->readResponseBody();
+		if(!req->isFinished())
+			return;
+
+		const Item &i = items[req];
+		log_debug("prewarmed %s in %dms", i.uri.toEncoded().data(), (int)i.time.elapsed());
+
+		finish(req);
+	}
+
+	void req_error()
+	{
+		HttpRequest *req = (HttpRequest *)sender();
+
+		log_warning("failed to prewarm %s", items[req].uri.toEncoded().data());
+
+		finish(req);
+	}
+};
+
+ConnectionWarmer::ConnectionWarmer(QObject *parent) :
+	QObject(parent)
+{
+	d = new Private(this);
+}
+
+ConnectionWarmer::~ConnectionWarmer()
+{
+	delete d;
+}
+
+void ConnectionWarmer::setAllowIPv6(bool on)
+{
+	d->allowIPv6 = on;
+}
+
+void ConnectionWarmer::start(const QList<QUrl> &uris, int count)
+{
+	d->start(uris, count);
+}
+
+#include "connectionwarmer.moc"
@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2026 Fanout, Inc.
+ *
+ * This file is part of Zurl.
+ *
+ * $FANOUT_BEGIN_LICENSE:GPL$
+ *
+ * Zurl is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zurl is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Zurl may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#ifndef CONNECTIONWARMER_H
+#define CONNECTIONWARMER_H
+
+#include <QObject>
+
+class QUrl;
+
+// opens keep-alive connections to a set of hosts ahead of any requests to
+//   them, by making HEAD requests. the connections are left idle in the
+//   pool of the calling thread's connection manager, where later requests
+//   from the same thread pick them up
+
+class ConnectionWarmer : public QObject
+{
+	Q_OBJECT
+
+public:
+	ConnectionWarmer(QObject *parent = 0);
+	~ConnectionWarmer();
+
+	void setAllowIPv6(bool on);
+
+	// uris are http or https, and only the origin matters. count requests
+	//   are made to each at once, so as many connections are opened. a
+	//   host still being warmed from a previous call is skipped
+	void start(const QList<QUrl> &uris, int count = 1);
+
+signals:
+	// emitted when no more requests are in progress
+	void finished();
+
+private:
+	class Private;
+	friend class Private;
+	Private *d;
+};
+
+#endif
@@ -0,0 +1,186 @@
+/*
+ * Copyright (C) 2026 Fanout, Inc.
+ *
+ * This file is part of Zurl.
+ *
+ * $FANOUT_BEGIN_LICENSE:GPL$
+ *
+ * Zurl is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zurl is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Zurl may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#include "engine.h"
+
+#include <QSet>
+#include <QHash>
+#include <QUrl>
+#include "logutil.h"
+#include "appconfig.h"
+#include "packetcoalescer.h"
+#include "hostlimiter.h"
+#include "connectionwarmer.h"
+
+class Engine::Private : public QObject
+{
+	Q_OBJECT
+
+public:
+	Engine *q;
+	AppConfig *config;
+	QSet<Worker*> workers;
+	QHash<QByteArray, Worker*> streamWorkersByRid;
+	QHash<Worker*, QList<QByteArray> > reqHeadersByWorker;
+	PacketCoalescer *coalescer;
+	HostLimiter *hostLimiter;
+	ConnectionWarmer *warmer;
+
+	Private(AppConfig *_config, Engine *_q) :
+		QObject(_q),
+		q(_q),
+		config(_config),
+		coalescer(0),
+		hostLimiter(0),
+		warmer(0)
+	{
+		if(config->coalesceInterval > 0)
+		{
+			coalescer = new PacketCoalescer(config, config->coalesceInterval, this);
+			connect(coalescer, &PacketCoalescer::readyRead, this, &Private::coalescer_readyRead);
+		}
+
+		if(config->maxHostRequests > 0)
+			hostLimiter = new HostLimiter(config->maxHostRequests, config->maxHostQueue, this);
+	}
+
+	~Private()
+	{
+		// workers release their host slots on destruction
+		qDeleteAll(workers);
+		workers.clear();
+	}
+
+	void start(Worker::Format format, const QByteArray &rid, int seq, const ZhttpRequestPacket &request, Worker::Mode mode, const QList<QByteArray> &reqHeaders, const ZhttpCodec::RequestExtras &extras)
+	{
+		if(!rid.isEmpty() && streamWorkersByRid.contains(rid))
+		{
+			log_warning("received request for id already in use, skipping");
+			emit q->workerFinished();
+			return;
+		}
+
+		Worker *w = new Worker(config, format, this);
+		connect(w, &Worker::readyRead, this, &Private::worker_readyRead);
+		connect(w, &Worker::finished, this, &Private::worker_finished);
+
+		workers += w;
+
+		if(mode == Worker::Stream && !rid.isEmpty())
+		{
+			streamWorkersByRid[rid] = w;
+			w->setCoalescer(coalescer);
+		}
+		else if(mode == Worker::Single)
+			reqHeadersByWorker[w] = reqHeaders;
+
+		w->setHostLimiter(hostLimiter);
+		w->setRequestExtras(extras);
+		w->start(rid, seq, request, mode);
+	}
+
+	void write(const QByteArray &rid, int seq, const ZhttpRequestPacket &request)
+	{
+		Worker *w = streamWorkersByRid.value(rid);
+		if(!w)
+		{
+			if((request.type != ZhttpRequestPacket::Error && request.type != ZhttpRequestPacket::Cancel) && !request.from.isEmpty())
+				emit q->sessionNotFound(request.from, rid);
+
+			return;
+		}
+
+		w->write(seq, request);
+	}
+
+	void prewarm(const QList<QUrl> &uris, int count)
+	{
+		if(!warmer)
+		{
+			warmer = new ConnectionWarmer(this);
+			warmer->setAllowIPv6(config->allowIPv6);
+		}
+
+		warmer->start(uris, count);
+	}
+
+private slots:
+	void worker_readyRead(const QByteArray &receiver, const ZhttpResponsePacket &response)
+	{
+		Worker *w = (Worker *)sender();
+
+		emit q->readyRead(w->format(), receiver, reqHeadersByWorker.value(w), response);
+	}
+
+	void coalescer_readyRead(Worker::Format format, const QByteArray &receiver, const ZhttpResponsePacket &response)
+	{
+		emit q->readyRead(format, receiver, QList<QByteArray>(), response);
+	}
+
+	void worker_finished()
+	{
+		Worker *w = (Worker *)sender();
+
+		if(!w->rid().isEmpty())
+			streamWorkersByRid.remove(w->rid());
+		reqHeadersByWorker.remove(w);
+		workers.remove(w);
+
+		delete w;
+
+		emit q->workerFinished();
+	}
+};
+
+Engine::Engine(AppConfig *config, QObject *parent) :
+	QObject(parent)
+{
+	d = new Private(config, this);
+}
+
+Engine::~Engine()
+{
+	delete d;
+}
+
+void Engine::start(Worker::Format format, const QByteArray &rid, int seq, const ZhttpRequestPacket &request, Worker::Mode mode, const QList<QByteArray> &reqHeaders, const ZhttpCodec::RequestExtras &extras)
+{
+	d->start(format, rid, seq, request, mode, reqHeaders, extras);
+}
+
+void Engine::write(const QByteArray &rid, int seq, const ZhttpRequestPacket &request)
+{
+	d->write(rid, seq, request);
+}
+
+void Engine::prewarm(const QList<QUrl> &uris, int count)
+{
+	d->prewarm(uris, count);
+}
+
+#include "engine.moc"
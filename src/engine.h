@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2026 Fanout, Inc.
+ *
+ * This file is part of Zurl.
+ *
+ * $FANOUT_BEGIN_LICENSE:GPL$
+ *
+ * Zurl is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zurl is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Zurl may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include <QObject>
+#include <QMetaType>
+#include "zhttprequestpacket.h"
+#include "zhttpresponsepacket.h"
+#include "zhttpcodec.h"
+#include "worker.h"
+
+class QUrl;
+class AppConfig;
+
+// an engine owns a set of workers and runs them on whatever thread it
+//   lives in. the app routes sessions to engines by request id, so all
+//   packets for a given session are handled by the same engine
+
+class Engine : public QObject
+{
+	Q_OBJECT
+
+public:
+	Engine(AppConfig *config, QObject *parent = 0);
+	~Engine();
+
+	void start(Worker::Format format, const QByteArray &rid, int seq, const ZhttpRequestPacket &request, Worker::Mode mode, const QList<QByteArray> &reqHeaders = QList<QByteArray>(), const ZhttpCodec::RequestExtras &extras = ZhttpCodec::RequestExtras());
+	void write(const QByteArray &rid, int seq, const ZhttpRequestPacket &request);
+
+	// opens count idle connections to each uri, in the pool of the thread
+	//   the engine lives in
+	void prewarm(const QList<QUrl> &uris, int count);
+
+signals:
+	// receiver is empty for responses to the router interface, in which
+	//   case reqHeaders contains the routing envelope
+	void readyRead(Worker::Format format, const QByteArray &receiver, const QList<QByteArray> &reqHeaders, const ZhttpResponsePacket &response);
+
+	// emitted when a stream packet refers to a session we don't have
+	void sessionNotFound(const QByteArray &receiver, const QByteArray &rid);
+
+	// emitted once for every call to start(), including rejected ones
+	void workerFinished();
+
+private:
+	class Private;
+	friend class Private;
+	Private *d;
+};
+
+Q_DECLARE_METATYPE(ZhttpResponsePacket)
+
+#endif
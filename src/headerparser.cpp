@@ -0,0 +1,207 @@
+/*
+ * Copyright (C) 2026 Fanout, Inc.
+ *
+ * This file is part of Zurl.
+ *
+ * $FANOUT_BEGIN_LICENSE:GPL$
+ *
+ * Zurl is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zurl is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Zurl may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#include "headerparser.h"
+
+#include <string.h>
+#include <QVector>
+
+#define INITIAL_BLOCK_SIZE 4096
+
+// names longer than this are never interned
+#define MAX_INTERNED_SIZE 40
+
+static const char *commonNames[] =
+{
+	"Accept-Ranges",
+	"Access-Control-Allow-Credentials",
+	"Access-Control-Allow-Headers",
+	"Access-Control-Allow-Methods",
+	"Access-Control-Allow-Origin",
+	"Access-Control-Expose-Headers",
+	"Access-Control-Max-Age",
+	"Age",
+	"Allow",
+	"Alt-Svc",
+	"Cache-Control",
+	"Connection",
+	"Content-Disposition",
+	"Content-Encoding",
+	"Content-Language",
+	"Content-Length",
+	"Content-Location",
+	"Content-Range",
+	"Content-Security-Policy",
+	"Content-Type",
+	"Date",
+	"ETag",
+	"Expires",
+	"Keep-Alive",
+	"Last-Modified",
+	"Link",
+	"Location",
+	"Pragma",
+	"Referrer-Policy",
+	"Retry-After",
+	"Server",
+	"Set-Cookie",
+	"Strict-Transport-Security",
+	"Transfer-Encoding",
+	"Vary",
+	"Via",
+	"WWW-Authenticate",
+	"X-Content-Type-Options",
+	"X-Frame-Options",
+	"X-Powered-By",
+	"X-Request-Id",
+	"X-XSS-Protection",
+	0
+};
+
+class InternTable
+{
+public:
+	// indexed by name size
+	QVector<QByteArray> bySize[MAX_INTERNED_SIZE + 1];
+
+	InternTable()
+	{
+		// http/1 servers tend to use the usual capitalization, and http/2
+		//   names are always lowercase
+		for(int n = 0; commonNames[n]; ++n)
+		{
+			QByteArray name(commonNames[n]);
+			Q_ASSERT(name.size() <= MAX_INTERNED_SIZE);
+
+			bySize[name.size()] += name;
+			bySize[name.size()] += name.toLower();
+		}
+	}
+};
+
+static const InternTable *internTable()
+{
+	static InternTable table;
+	return &table;
+}
+
+HeaderParser::HeaderParser()
+{
+	block_.reserve(INITIAL_BLOCK_SIZE);
+}
+
+bool HeaderParser::addLine(const char *line, int size)
+{
+	const char *colon = (const char *)memchr(line, ':', size);
+	if(!colon || colon == line)
+		return false;
+
+	int nameSize = colon - line;
+
+	int at = nameSize + 1;
+	while(at < size && (line[at] == ' ' || line[at] == '\t'))
+		++at;
+
+	Entry e;
+	e.nameStart = block_.size();
+	e.nameSize = nameSize;
+	e.valueStart = e.nameStart + at;
+	e.valueSize = size - at;
+	entries_.append(e);
+
+	block_.append(line, size);
+
+	return true;
+}
+
+int HeaderParser::find(const char *name) const
+{
+	int size = strlen(name);
+	const char *data = block_.constData();
+
+	for(int n = 0; n < entries_.count(); ++n)
+	{
+		const Entry &e = entries_[n];
+		if(e.nameSize == size && qstrnicmp(data + e.nameStart, name, size) == 0)
+			return n;
+	}
+
+	return -1;
+}
+
+bool HeaderParser::contains(const char *name) const
+{
+	return (find(name) != -1);
+}
+
+QByteArray HeaderParser::value(const char *name) const
+{
+	int n = find(name);
+	if(n == -1)
+		return QByteArray();
+
+	const Entry &e = entries_[n];
+	return QByteArray(block_.constData() + e.valueStart, e.valueSize);
+}
+
+HttpHeaders HeaderParser::toHeaders() const
+{
+	HttpHeaders out;
+	out.reserve(entries_.count());
+
+	const char *data = block_.constData();
+
+	for(int n = 0; n < entries_.count(); ++n)
+	{
+		const Entry &e = entries_[n];
+		out += HttpHeader(internName(data + e.nameStart, e.nameSize), QByteArray(data + e.valueStart, e.valueSize));
+	}
+
+	return out;
+}
+
+void HeaderParser::clear()
+{
+	// capacity is kept since it was reserved
+	block_.resize(0);
+	entries_.clear();
+}
+
+QByteArray HeaderParser::internName(const char *name, int size)
+{
+	if(size <= MAX_INTERNED_SIZE)
+	{
+		foreach(const QByteArray &i, internTable()->bySize[size])
+		{
+			if(memcmp(i.constData(), name, size) == 0)
+				return i;
+		}
+	}
+
+	return QByteArray(name, size);
+}
@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2026 Fanout, Inc.
+ *
+ * This file is part of Zurl.
+ *
+ * $FANOUT_BEGIN_LICENSE:GPL$
+ *
+ * Zurl is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zurl is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Zurl may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#ifndef HEADERPARSER_H
+#define HEADERPARSER_H
+
+#include <QByteArray>
+#include <QVarLengthArray>
+#include "httpheaders.h"
+
+// collects the header lines of a response into one buffer, recording
+//   where each name and value is. nothing else is allocated until
+//   toHeaders(), so header blocks that get discarded (100 continue,
+//   followed redirects) cost only the copy into the buffer. common header
+//   names come out of toHeaders() as shared strings rather than new
+//   allocations
+
+class HeaderParser
+{
+public:
+	HeaderParser();
+
+	int count() const { return entries_.count(); }
+
+	// line is without the line ending. returns false if malformed
+	bool addLine(const char *line, int size);
+
+	// case insensitive
+	bool contains(const char *name) const;
+	QByteArray value(const char *name) const;
+
+	HttpHeaders toHeaders() const;
+
+	// keeps the buffer for reuse
+	void clear();
+
+	// returns a shared instance if the name is a common one, written
+	//   exactly the same way
+	static QByteArray internName(const char *name, int size);
+
+private:
+	class Entry
+	{
+	public:
+		int nameStart;
+		int nameSize;
+		int valueStart;
+		int valueSize;
+	};
+
+	QByteArray block_;
+	QVarLengthArray<Entry, 64> entries_;
+
+	int find(const char *name) const;
+};
+
+#endif
@@ -0,0 +1,183 @@
+/*
+ * Copyright (C) 2026 Fanout, Inc.
+ *
+ * This file is part of Zurl.
+ *
+ * $FANOUT_BEGIN_LICENSE:GPL$
+ *
+ * Zurl is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zurl is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Zurl may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#include "hostlimiter.h"
+
+#include <QHash>
+#include <QSet>
+#include <QPointer>
+#include <QElapsedTimer>
+#include "stats.h"
+
+class HostLimiter::Private : public QObject
+{
+	Q_OBJECT
+
+public:
+	class Waiter
+	{
+	public:
+		QObject *owner;
+		std::function<void ()> onAcquired;
+		QElapsedTimer waitTime;
+	};
+
+	class Host
+	{
+	public:
+		QSet<QObject*> active;
+		QList<Waiter> queue;
+	};
+
+	HostLimiter *q;
+	int maxActive;
+	int maxQueued;
+	QHash<QByteArray, Host*> hosts;
+
+	Private(HostLimiter *_q, int _maxActive, int _maxQueued) :
+		QObject(_q),
+		q(_q),
+		maxActive(_maxActive),
+		maxQueued(_maxQueued)
+	{
+	}
+
+	~Private()
+	{
+		foreach(Host *h, hosts)
+			Stats::add(Stats::HostQueueDepth, -h->queue.count());
+
+		qDeleteAll(hosts);
+	}
+
+	Result acquire(const QByteArray &host, QObject *owner, const std::function<void ()> &onAcquired)
+	{
+		Host *h = hosts.value(host);
+		if(!h)
+		{
+			h = new Host;
+			hosts.insert(host, h);
+		}
+
+		if(h->active.count() < maxActive)
+		{
+			h->active += owner;
+			return Acquired;
+		}
+
+		if(maxQueued > 0 && h->queue.count() >= maxQueued)
+		{
+			Stats::add(Stats::HostQueueRejected);
+			return Rejected;
+		}
+
+		Waiter w;
+		w.owner = owner;
+		w.onAcquired = onAcquired;
+		w.waitTime.start();
+		h->queue += w;
+		Stats::add(Stats::HostQueueDepth);
+
+		return Queued;
+	}
+
+	void release(const QByteArray &host, QObject *owner)
+	{
+		Host *h = hosts.value(host);
+		if(!h)
+			return;
+
+		if(h->active.remove(owner))
+		{
+			promote(h);
+		}
+		else
+		{
+			for(int n = 0; n < h->queue.count(); ++n)
+			{
+				if(h->queue[n].owner == owner)
+				{
+					h->queue.removeAt(n);
+					Stats::add(Stats::HostQueueDepth, -1);
+					break;
+				}
+			}
+		}
+
+		if(h->active.isEmpty() && h->queue.isEmpty())
+		{
+			hosts.remove(host);
+			delete h;
+		}
+	}
+
+	void promote(Host *h)
+	{
+		while(!h->queue.isEmpty() && h->active.count() < maxActive)
+		{
+			Waiter w = h->queue.takeFirst();
+			Stats::add(Stats::HostQueueDepth, -1);
+			Stats::record(Stats::HostQueueWaitTime, w.waitTime.nsecsElapsed() / 1000);
+
+			h->active += w.owner;
+
+			// the slot is taken now, but the callback runs later so the
+			//   releasing request isn't reentered. the owner releases the
+			//   slot if it goes away before then
+			QPointer<QObject> owner = w.owner;
+			std::function<void ()> onAcquired = w.onAcquired;
+			QMetaObject::invokeMethod(this, [=]() {
+				if(owner)
+					onAcquired();
+			}, Qt::QueuedConnection);
+		}
+	}
+};
+
+HostLimiter::HostLimiter(int maxActive, int maxQueued, QObject *parent) :
+	QObject(parent)
+{
+	d = new Private(this, maxActive, maxQueued);
+}
+
+HostLimiter::~HostLimiter()
+{
+	delete d;
+}
+
+HostLimiter::Result HostLimiter::acquire(const QByteArray &host, QObject *owner, const std::function<void ()> &onAcquired)
+{
+	return d->acquire(host, owner, onAcquired);
+}
+
+void HostLimiter::release(const QByteArray &host, QObject *owner)
+{
+	d->release(host, owner);
+}
+
+#include "hostlimiter.moc"
@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2026 Fanout, Inc.
+ *
+ * This file is part of Zurl.
+ *
+ * $FANOUT_BEGIN_LICENSE:GPL$
+ *
+ * Zurl is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zurl is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Zurl may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#ifndef HOSTLIMITER_H
+#define HOSTLIMITER_H
+
+#include <functional>
+#include <QObject>
+
+// limits the number of requests in progress per destination host. requests
+//   beyond the limit wait in a per-host queue, so a slow host holds back
+//   only its own requests. when a slot frees up, the next waiter's
+//   callback is invoked from the event loop
+
+class HostLimiter : public QObject
+{
+	Q_OBJECT
+
+public:
+	enum Result
+	{
+		Acquired,
+		Queued,
+		Rejected // the host's queue is full
+	};
+
+	// maxQueued of 0 means no limit
+	HostLimiter(int maxActive, int maxQueued, QObject *parent = 0);
+	~HostLimiter();
+
+	// onAcquired is only called if the result is Queued. owner identifies
+	//   the request, and must call release() when done, whether it was
+	//   acquired or is still queued
+	Result acquire(const QByteArray &host, QObject *owner, const std::function<void ()> &onAcquired);
+
+	void release(const QByteArray &host, QObject *owner);
+
+private:
+	class Private;
+	friend class Private;
+	Private *d;
+};
+
+#endif
@@ -29,29 +29,147 @@
 #include "httprequest.h"
 
 #include <assert.h>
+#include <string.h>
 #include <sys/select.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <unistd.h>
+#ifdef Q_OS_LINUX
+#include <sys/epoll.h>
+#endif
 #ifdef HAVE_OPENSSL
 #include <openssl/ssl.h>
 #endif
 #include <QSet>
+#include <QMutex>
+#include <QThread>
+#include <QThreadStorage>
 #include <QCoreApplication>
 #include <QSocketNotifier>
 #include <QTimer>
 #include <QPointer>
 #include <QHostAddress>
 #include <QUrl>
+#include <QElapsedTimer>
+#include <QRandomGenerator>
 #include <curl/curl.h>
-#include "bufferlist.h"
-#include "log.h"
+#include "chunkbuffer.h"
+#include "headerparser.h"
+#include "bodybuffer.h"
+#include "logutil.h"
 #include "verifyhost.h"
+#include "stats.h"
 
-#define BUFFER_SIZE 200000
+// curl reads at most this much at a time. receive buffers start at one
+//   chunk and grow, up to the configured max, for transfers whose consumer
+//   doesn't keep up
+#define INITIAL_BUFFER_SIZE 16384
 #define REQUEST_BODY_BUFFER_MAX 1000000
 
-// workaround for earlier curl versions
-#define UNPAUSE_WORKAROUND 1
+// max sockets handled per wakeup of the epoll backend
+#define EPOLL_BATCH_SIZE 256
+
+// idle easy handles kept per thread for reuse
+#define EASY_POOL_MAX 256
+
+// since 7.68.0, unpausing a transfer expires its timer, so driving the
+//   multi handle with CURL_SOCKET_TIMEOUT only touches the transfers that
+//   were unpaused. earlier versions need every transfer driven
+#define TARGETED_UNPAUSE_MIN_VERSION 0x074400
+
+// since 7.80.0, curl can retire each connection individually once it
+//   reaches a max age. earlier versions get the whole pool replaced
+#define MAXLIFETIME_CONN_MIN_VERSION 0x075000
+
+static bool g_targetedUnpause = true;
+static int g_maxConcurrentStreams = 0;
+static int g_maxHostConnections = 0; // 0 for no limit
+static int g_maxTotalConnections = 0; // 0 for no limit
+static int g_maxBufferSize = 200000;
+static HttpRequest::EventBackend g_eventBackend = HttpRequest::QtEventBackend;
+
+static bool curlSupportsTargetedUnpause()
+{
+	static const bool supported = (curl_version_info(CURLVERSION_NOW)->version_num >= TARGETED_UNPAUSE_MIN_VERSION);
+	return supported;
+}
+
+static bool curlSupportsMaxLifetime()
+{
+#if LIBCURL_VERSION_NUM >= MAXLIFETIME_CONN_MIN_VERSION
+	static const bool supported = (curl_version_info(CURLVERSION_NOW)->version_num >= MAXLIFETIME_CONN_MIN_VERSION);
+	return supported;
+#else
+	return false;
+#endif
+}
+
+// dns and tls session caches shared by all connection managers, in all
+//   threads. the connection cache is not shared, since curl doesn't
+//   support using shared connections from concurrent threads, and all
+//   transfers of a thread already share a multi handle
+
+static QMutex g_shareLocks[CURL_LOCK_DATA_LAST];
+
+static void shareLock_cb(CURL *handle, curl_lock_data data, curl_lock_access access, void *userptr)
+{
+	Q_UNUSED(handle);
+	Q_UNUSED(access);
+	Q_UNUSED(userptr);
+
+	g_shareLocks[data].lock();
+}
+
+static void shareUnlock_cb(CURL *handle, curl_lock_data data, void *userptr)
+{
+	Q_UNUSED(handle);
+	Q_UNUSED(userptr);
+
+	g_shareLocks[data].unlock();
+}
+
+static CURLSH *createShare()
+{
+	CURLSH *share = curl_share_init();
+	curl_share_setopt(share, CURLSHOPT_LOCKFUNC, shareLock_cb);
+	curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC, shareUnlock_cb);
+	curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+	curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+	return share;
+}
+
+// http/2 status lines have no reason phrase
+static QByteArray defaultReason(int code)
+{
+	switch(code)
+	{
+		case 200: return "OK";
+		case 201: return "Created";
+		case 202: return "Accepted";
+		case 204: return "No Content";
+		case 206: return "Partial Content";
+		case 301: return "Moved Permanently";
+		case 302: return "Found";
+		case 303: return "See Other";
+		case 304: return "Not Modified";
+		case 307: return "Temporary Redirect";
+		case 308: return "Permanent Redirect";
+		case 400: return "Bad Request";
+		case 401: return "Unauthorized";
+		case 403: return "Forbidden";
+		case 404: return "Not Found";
+		case 405: return "Method Not Allowed";
+		case 409: return "Conflict";
+		case 410: return "Gone";
+		case 413: return "Payload Too Large";
+		case 429: return "Too Many Requests";
+		case 500: return "Internal Server Error";
+		case 502: return "Bad Gateway";
+		case 503: return "Service Unavailable";
+		case 504: return "Gateway Timeout";
+		default: return "";
+	}
+}
 
 static const char *socketActionToString(int x)
 {
@@ -75,6 +193,73 @@ static const char *msgToString(int x)
 	}
 }
 
+// tracks the age of each connection opened on this thread. curl applies
+//   CURLOPT_MAXLIFETIME_CONN of whichever transfer wants to reuse a
+//   connection, so a jittered limit there can't be tied to the connection.
+//   instead each connection is given its own retirement time when opened,
+//   up to 20% short of the max time, and is shut down after a transfer
+//   finds it past that time. curl then sees it as dead rather than reusing
+//   it. the max time is still set on every transfer, as a backstop
+class ConnectionAgeTracker
+{
+public:
+	int maxTime; // seconds
+	QElapsedTimer clock;
+	QHash<curl_socket_t, qint64> retireTimes; // msecs on the clock
+
+	ConnectionAgeTracker() :
+		maxTime(0)
+	{
+		clock.start();
+	}
+
+	void opened(curl_socket_t s)
+	{
+		if(maxTime <= 0)
+			return;
+
+		qint64 maxMsecs = (qint64)maxTime * 1000;
+		qint64 jitter = QRandomGenerator::global()->bounded(maxMsecs / 5 + 1);
+		retireTimes[s] = clock.elapsed() + maxMsecs - jitter;
+	}
+
+	// must be called after the transfer of easy is done
+	void retireIfExpired(CURL *easy)
+	{
+#if LIBCURL_VERSION_NUM >= MAXLIFETIME_CONN_MIN_VERSION
+		// the socket is only reported if curl kept the connection
+		curl_socket_t s = CURL_SOCKET_BAD;
+		curl_easy_getinfo(easy, CURLINFO_ACTIVESOCKET, &s);
+		if(s == CURL_SOCKET_BAD)
+			return;
+
+		// an http/2 connection may still be carrying other streams. it is
+		//   left to the backstop
+		long version = 0;
+		curl_easy_getinfo(easy, CURLINFO_HTTP_VERSION, &version);
+		if(version == CURL_HTTP_VERSION_2_0)
+			return;
+
+		QHash<curl_socket_t, qint64>::iterator it = retireTimes.find(s);
+		if(it == retireTimes.end() || clock.elapsed() < it.value())
+			return;
+
+		retireTimes.erase(it);
+		::shutdown(s, SHUT_RDWR);
+		log_debug("retiring connection: %d", (int)s);
+#else
+		Q_UNUSED(easy);
+#endif
+	}
+
+	static int closeSocket_cb(void *clientp, curl_socket_t item)
+	{
+		ConnectionAgeTracker *self = (ConnectionAgeTracker *)clientp;
+		self->retireTimes.remove(item);
+		return ::close(item);
+	}
+};
+
 class CurlConnection : public QObject
 {
 	Q_OBJECT
@@ -90,15 +275,19 @@ public:
 	struct curl_slist *headersList;
 	bool addressBlocked;
 	int pauseBits;
-	BufferList in;
-	BufferList out;
-	int outPos;
+	ChunkBuffer in;
+	int inMax;
+	bool tlsChecked;
+	bool decodeContent;
+	ConnectionAgeTracker *ageTracker;
+	BodyBuffer out;
 	bool inFinished;
 	bool outFinished;
 	bool haveStatusLine;
 	int responseCode;
 	QByteArray responseReason;
 	bool haveResponseHeaders;
+	HeaderParser headerParser;
 	HttpHeaders responseHeaders;
 	bool newlyReadOrEof;
 	int newlyWritten;
@@ -106,7 +295,9 @@ public:
 	CURLcode result;
 	QStringList checkHosts;
 
-	CurlConnection() :
+	// the handle may come from the pool, already reset
+	CurlConnection(CURL *_easy) :
+		easy(_easy),
 		maxRedirects(-1),
 		expectBody(false),
 		alwaysSetBody(false),
@@ -115,7 +306,10 @@ public:
 		headersList(NULL),
 		addressBlocked(false),
 		pauseBits(0),
-		outPos(0),
+		inMax(ChunkBuffer::ChunkSize),
+		tlsChecked(false),
+		decodeContent(true),
+		ageTracker(0),
 		inFinished(false),
 		outFinished(false),
 		haveStatusLine(false),
@@ -124,8 +318,6 @@ public:
 		newlyWritten(0),
 		pendingUpdate(false)
 	{
-		easy = curl_easy_init();
-
 		curl_easy_setopt(easy, CURLOPT_PRIVATE, this);
 		curl_easy_setopt(easy, CURLOPT_DEBUGFUNCTION, debugFunction_cb);
 		curl_easy_setopt(easy, CURLOPT_DEBUGDATA, this);
@@ -146,7 +338,13 @@ public:
 		curl_easy_setopt(easy, CURLOPT_SSL_CTX_DATA, this);
 #endif
 
-		curl_easy_setopt(easy, CURLOPT_BUFFERSIZE, (long)BUFFER_SIZE);
+		// every connection gets its initial chunk, even over budget, so
+		//   that it can always make progress
+		ChunkBuffer::reserveMemory(inMax, true);
+		Stats::add(Stats::BufferBytesReserved, inMax);
+
+		// 1024 is the smallest buffer curl accepts
+		curl_easy_setopt(easy, CURLOPT_BUFFERSIZE, (long)qMax(qMin(INITIAL_BUFFER_SIZE, g_maxBufferSize), 1024));
 		curl_easy_setopt(easy, CURLOPT_ENCODING, "");
 		curl_easy_setopt(easy, CURLOPT_HTTP_CONTENT_DECODING, 1L);
 
@@ -160,7 +358,11 @@ public:
 
 	~CurlConnection()
 	{
-		curl_easy_cleanup(easy);
+		ChunkBuffer::releaseMemory(inMax);
+		Stats::add(Stats::BufferBytesReserved, -inMax);
+
+		if(easy)
+			curl_easy_cleanup(easy);
 		curl_slist_free_all(connectTo);
 		curl_slist_free_all(headersList);
 	}
@@ -362,7 +564,7 @@ public:
 	{
 		Q_UNUSED(easy);
 
-		if(type == CURLINFO_TEXT)
+		if(type == CURLINFO_TEXT && log_outputLevel() >= LOG_LEVEL_DEBUG)
 		{
 			QByteArray str(ptr, size);
 			if(str[str.length() - 1] == '\n')
@@ -378,7 +580,12 @@ public:
 		if(size == 0)
 			return 0;
 
-		if(in.size() + size > BUFFER_SIZE)
+		// an empty buffer always takes the data, since curl would
+		//   otherwise hand us the same amount again after unpausing. the
+		//   limit is on chunk memory, which includes the read part of the
+		//   first chunk and the unused part of the last
+		int needed = in.capacityAfter((int)size);
+		if(!in.isEmpty() && needed > inMax && !growBuffer(needed))
 		{
 			// pause if we can't fit the data
 			log_debug("writeFunction: pausing");
@@ -388,7 +595,7 @@ public:
 		else
 		{
 			log_debug("writeFunction: accepting %d bytes", size);
-			in += QByteArray(p, size);
+			in.append(p, size);
 			newlyReadOrEof = true;
 			update();
 		}
@@ -398,35 +605,20 @@ public:
 
 	size_t readFunction(char *p, size_t size)
 	{
-		QByteArray buf;
-
-		if(outPos >= 0 && out.size() > REQUEST_BODY_BUFFER_MAX)
+		if(out.isRetaining() && out.size() > REQUEST_BODY_BUFFER_MAX)
 		{
 			// exceeded buffer max, switch to unbuffered
-			QByteArray remaining = out.mid(outPos);
-			out.clear();
-			out += remaining;
-			outPos = -1;
+			out.setRetaining(false);
 		}
 
-		if(outPos >= 0)
-		{
-			buf = out.mid(outPos, size);
-			outPos += buf.size();
-		}
-		else
-		{
-			buf = out.take(size);
-		}
-
-		if(!buf.isEmpty())
+		int count = out.read(p, size);
+		if(count > 0)
 		{
 			bodyReadFrom = true;
-			memcpy(p, buf.data(), buf.size());
-			newlyWritten += buf.size();
-			log_debug("readFunction: providing %d bytes", buf.size());
+			newlyWritten += count;
+			log_debug("readFunction: providing %d bytes", count);
 			update();
-			return buf.size();
+			return count;
 		}
 		else
 		{
@@ -444,9 +636,39 @@ public:
 		}
 	}
 
+	// body bytes the buffer is sure to hold before the transfer pauses, if
+	//   it can't grow. the read part of the first chunk is unusable, and a
+	//   write from curl that doesn't fit in the rest is refused whole
+	int guaranteedCapacity() const
+	{
+		int readSize = qMax(qMin(INITIAL_BUFFER_SIZE, g_maxBufferSize), 1024);
+		int unusable = in.capacity() - in.size() - in.spare();
+		return qMax(inMax - unusable - (readSize - 1), 1);
+	}
+
+	// reservations are in whole chunks, matching what the buffer allocates
+	bool growBuffer(int needed)
+	{
+		int max = qMax(ChunkBuffer::alignToChunks(g_maxBufferSize), (int)ChunkBuffer::ChunkSize);
+		while(inMax < needed && inMax < max)
+		{
+			int newMax = qMin(inMax * 2, max);
+			if(!ChunkBuffer::reserveMemory(newMax - inMax))
+			{
+				Stats::add(Stats::BufferGrowDenied);
+				break;
+			}
+
+			Stats::add(Stats::BufferBytesReserved, newMax - inMax);
+			inMax = newMax;
+		}
+
+		return (needed <= inMax);
+	}
+
 	int seekFunction(curl_off_t offset, int origin)
 	{
-		if(outPos < 0)
+		if(!out.isRetaining())
 		{
 			log_debug("seekFunction: can't seek. input is unbuffered");
 			return 1;
@@ -454,9 +676,8 @@ public:
 
 		if(origin == SEEK_SET)
 		{
-			if(offset <= out.size())
+			if(out.seek(offset))
 			{
-				outPos = offset;
 				log_debug("seekFunction: seeking to position %ld", offset);
 				return 0;
 			}
@@ -473,10 +694,37 @@ public:
 		}
 	}
 
+#ifdef HAVE_OPENSSL
+	// called once the connection is up. counts handshakes of new tls
+	//   connections, and how many of them resumed a cached session
+	void checkTlsResumption()
+	{
+		tlsChecked = true;
+
+		long connects = 0;
+		curl_easy_getinfo(easy, CURLINFO_NUM_CONNECTS, &connects);
+		if(connects == 0)
+			return;
+
+		struct curl_tlssessioninfo *info = 0;
+		if(curl_easy_getinfo(easy, CURLINFO_TLS_SSL_PTR, &info) != CURLE_OK || !info || info->backend != CURLSSLBACKEND_OPENSSL || !info->internals)
+			return;
+
+		Stats::add(Stats::TlsHandshakes);
+		if(SSL_session_reused((SSL *)info->internals))
+			Stats::add(Stats::TlsSessionsResumed);
+	}
+#endif
+
 	size_t headerFunction(char *p, size_t size)
 	{
 		assert(p[size - 1] == '\n');
 
+#ifdef HAVE_OPENSSL
+		if(!tlsChecked)
+			checkTlsResumption();
+#endif
+
 		// curl doesn't protect us from \n vs \r\n
 		int len;
 		if(p[size - 2] == '\r')
@@ -484,18 +732,18 @@ public:
 		else
 			len = size - 1;
 
-		QByteArray line(p, len);
-		if(!line.isEmpty())
+		if(len > 0)
 		{
 			if(haveResponseHeaders)
 			{
 				// does it look like we're getting a status
 				//   line again? (happens when redirecting)
-				int at = line.indexOf(' ');
-				if(at != -1 && !line.mid(0, at).contains(':'))
+				const char *sp = (const char *)memchr(p, ' ', len);
+				if(sp && !memchr(p, ':', sp - p))
 				{
 					haveStatusLine = false;
 					haveResponseHeaders = false;
+					headerParser.clear();
 					responseHeaders.clear();
 				}
 			}
@@ -504,23 +752,26 @@ public:
 			{
 				if(haveStatusLine)
 				{
-					int at = line.indexOf(": ");
-					if(at == -1)
+					if(!headerParser.addLine(p, len))
 						return -1;
 
-					log_debug("response header: %s", line.data());
-					responseHeaders += HttpHeader(line.mid(0, at), line.mid(at + 2));
+					log_debug("response header: %.*s", len, p);
 				}
 				else
 				{
 					// status reason we have to parse ourselves
-					int at = line.indexOf(' ');
-					if(at == -1)
+					const char *sp = (const char *)memchr(p, ' ', len);
+					if(!sp)
 						return -1;
-					at = line.indexOf(' ', at + 1);
-					if(at == -1)
-						return -1;
-					responseReason = line.mid(at + 1);
+					int at = sp - p;
+					sp = (const char *)memchr(p + at + 1, ' ', len - at - 1);
+					if(sp)
+						responseReason = QByteArray(sp + 1, len - (sp - p) - 1);
+					else
+						responseReason.clear();
+
+					if(responseReason.isEmpty())
+						responseReason = defaultReason(QByteArray(p + at + 1, qMin(3, len - at - 1)).toInt());
 
 					haveStatusLine = true;
 				}
@@ -540,23 +791,31 @@ public:
 				log_debug("got code 100, ignoring this header block");
 				haveStatusLine = false;
 				haveResponseHeaders = false;
-				responseHeaders.clear();
+				headerParser.clear();
 				return size;
 			}
 
-			if(maxRedirects >= 0 && responseCode >= 300 && responseCode < 400 && responseHeaders.contains("Location"))
+			if(maxRedirects >= 0 && responseCode >= 300 && responseCode < 400 && headerParser.contains("Location"))
 			{
 				log_debug("got code 3xx and redirects enabled, ignoring this header block");
 				haveStatusLine = false;
 				haveResponseHeaders = false;
-				responseHeaders.clear();
+				headerParser.clear();
 				return size;
 			}
 
-			// if a content-encoding was used, don't provide content-length
-			QByteArray contentEncoding = responseHeaders.get("Content-Encoding");
-			if(!contentEncoding.isEmpty() && contentEncoding != "identity")
-				responseHeaders.removeAll("Content-Length");
+			// only the final header block is converted, and only once.
+			//   the result is shared with the response packet
+			responseHeaders = headerParser.toHeaders();
+
+			// if a content-encoding was used and we decoded the body,
+			//   don't provide content-length
+			if(decodeContent)
+			{
+				QByteArray contentEncoding = headerParser.value("Content-Encoding");
+				if(!contentEncoding.isEmpty() && contentEncoding != "identity")
+					responseHeaders.removeAll("Content-Length");
+			}
 
 			// tell the app we've got the header block
 			newlyReadOrEof = true;
@@ -589,7 +848,11 @@ public:
 			}
 		}
 
-		return socket(address->family, address->socktype, address->protocol);
+		curl_socket_t s = socket(address->family, address->socktype, address->protocol);
+		if(ageTracker && s != CURL_SOCKET_BAD)
+			ageTracker->opened(s);
+
+		return s;
 	}
 
 #ifdef HAVE_OPENSSL
@@ -621,11 +884,101 @@ public:
 	}
 #endif
 
+	void setHttpVersion(HttpRequest::HttpVersion version)
+	{
+		switch(version)
+		{
+			case HttpRequest::Http1_1:
+				curl_easy_setopt(easy, CURLOPT_HTTP_VERSION, (long)CURL_HTTP_VERSION_1_1);
+				break;
+#if LIBCURL_VERSION_NUM >= 0x073100
+			case HttpRequest::Http2:
+				curl_easy_setopt(easy, CURLOPT_HTTP_VERSION, (long)CURL_HTTP_VERSION_2TLS);
+				curl_easy_setopt(easy, CURLOPT_PIPEWAIT, 1L);
+				break;
+			case HttpRequest::Http2PriorKnowledge:
+				curl_easy_setopt(easy, CURLOPT_HTTP_VERSION, (long)CURL_HTTP_VERSION_2_PRIOR_KNOWLEDGE);
+				curl_easy_setopt(easy, CURLOPT_PIPEWAIT, 1L);
+				break;
+#endif
+			default:
+				break;
+		}
+	}
+
+	// the body is passed through as received, with its content-encoding
+	//   and content-length. acceptEncoding is what to advertise, or empty
+	//   for every encoding curl supports
+	void setPassthroughContent(const QByteArray &acceptEncoding)
+	{
+		decodeContent = false;
+
+		if(!acceptEncoding.isEmpty())
+			curl_easy_setopt(easy, CURLOPT_ENCODING, acceptEncoding.constData());
+		curl_easy_setopt(easy, CURLOPT_HTTP_CONTENT_DECODING, 0L);
+	}
+
+	HttpRequest::HttpVersion negotiatedHttpVersion()
+	{
+#if LIBCURL_VERSION_NUM >= 0x073200
+		long version = 0;
+		curl_easy_getinfo(easy, CURLINFO_HTTP_VERSION, &version);
+		if(version == CURL_HTTP_VERSION_2_0)
+			return HttpRequest::Http2;
+#endif
+
+		return HttpRequest::Http1_1;
+	}
+
+	bool connectionReused()
+	{
+		long connects = 0;
+		curl_easy_getinfo(easy, CURLINFO_NUM_CONNECTS, &connects);
+		return (connects == 0);
+	}
+
+	void recordTimes()
+	{
+		// curl reports each phase as seconds since the start of the
+		//   transfer
+		double nameLookup = 0, connect = 0, appConnect = 0, startTransfer = 0, total = 0;
+		curl_easy_getinfo(easy, CURLINFO_NAMELOOKUP_TIME, &nameLookup);
+		curl_easy_getinfo(easy, CURLINFO_CONNECT_TIME, &connect);
+		curl_easy_getinfo(easy, CURLINFO_APPCONNECT_TIME, &appConnect);
+		curl_easy_getinfo(easy, CURLINFO_STARTTRANSFER_TIME, &startTransfer);
+		curl_easy_getinfo(easy, CURLINFO_TOTAL_TIME, &total);
+
+		// connect time is zero if an existing connection was reused
+		if(connect > 0)
+		{
+			Stats::record(Stats::DnsTime, (qint64)(nameLookup * 1000000));
+			Stats::record(Stats::ConnectTime, (qint64)((connect - nameLookup) * 1000000));
+			if(appConnect > 0)
+				Stats::record(Stats::TlsTime, (qint64)((appConnect - connect) * 1000000));
+		}
+
+		long connects = 0;
+		curl_easy_getinfo(easy, CURLINFO_NUM_CONNECTS, &connects);
+		Stats::add(connects > 0 ? Stats::ConnectionsOpened : Stats::ConnectionsReused);
+
+		if(negotiatedHttpVersion() == HttpRequest::Http2)
+			Stats::add(Stats::Http2Requests);
+
+		Stats::record(Stats::FirstByteTime, (qint64)(startTransfer * 1000000));
+		Stats::record(Stats::TotalTime, (qint64)(total * 1000000));
+	}
+
 	void done(CURLcode _result)
 	{
 		inFinished = true;
 		result = _result;
 
+		if(result == CURLE_OK)
+			recordTimes();
+
+		if(ageTracker)
+			ageTracker->retireIfExpired(easy);
+
 		newlyReadOrEof = true;
 		update();
 	}
@@ -671,12 +1024,16 @@ public:
 
 	CURLM *multi;
 	QHash<QSocketNotifier*, SocketInfo*> snMap;
+	int epollFd;
+	QSocketNotifier *snEpoll;
 	QTimer *timer;
 	bool pendingUpdate;
 	QSet<CurlConnection*> connections;
 
 	CurlConnectionManager(QObject *parent = 0) :
 		QObject(parent),
+		epollFd(-1),
+		snEpoll(0),
 		timer(0),
 		pendingUpdate(false)
 	{
@@ -684,11 +1041,47 @@ public:
 		connect(timer, &QTimer::timeout, this, &CurlConnectionManager::timer_timeout);
 		timer->setSingleShot(true);
 
+		if(g_eventBackend == HttpRequest::EpollEventBackend)
+		{
+#ifdef Q_OS_LINUX
+			// all curl sockets go in one epoll set, and only the epoll fd
+			//   is watched by the qt event loop
+			epollFd = epoll_create1(EPOLL_CLOEXEC);
+			if(epollFd != -1)
+			{
+				snEpoll = new QSocketNotifier(epollFd, QSocketNotifier::Read, this);
+				connect(snEpoll, &QSocketNotifier::activated, this, &CurlConnectionManager::snEpoll_activated);
+			}
+			else
+				log_warning("failed to create epoll instance, using default event backend");
+#else
+			log_warning("epoll not available on this platform, using default event backend");
+#endif
+		}
+
 		multi = curl_multi_init();
 		curl_multi_setopt(multi, CURLMOPT_SOCKETFUNCTION, socketFunction_cb);
 		curl_multi_setopt(multi, CURLMOPT_SOCKETDATA, this);
 		curl_multi_setopt(multi, CURLMOPT_TIMERFUNCTION, timerFunction_cb);
 		curl_multi_setopt(multi, CURLMOPT_TIMERDATA, this);
+
+		// http/2 requests to the same host share a connection
+#if LIBCURL_VERSION_NUM >= 0x072b00
+		curl_multi_setopt(multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+#endif
+#if LIBCURL_VERSION_NUM >= 0x074300
+		if(g_maxConcurrentStreams > 0)
+			curl_multi_setopt(multi, CURLMOPT_MAX_CONCURRENT_STREAMS, (long)g_maxConcurrentStreams);
+#endif
+
+		// transfers beyond these limits wait inside curl for a
+		//   connection to free up
+#if LIBCURL_VERSION_NUM >= 0x071e00
+		if(g_maxHostConnections > 0)
+			curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS, (long)g_maxHostConnections);
+		if(g_maxTotalConnections > 0)
+			curl_multi_setopt(multi, CURLMOPT_MAX_TOTAL_CONNECTIONS, (long)g_maxTotalConnections);
+#endif
 	}
 
 	~CurlConnectionManager()
@@ -696,6 +1089,12 @@ public:
 		assert(connections.isEmpty());
 
 		curl_multi_cleanup(multi);
+
+		if(epollFd != -1)
+		{
+			delete snEpoll;
+			close(epollFd);
+		}
 	}
 
 	void update()
@@ -723,14 +1122,18 @@ public:
 	{
 		Q_UNUSED(easy);
 
-		const char *str = socketActionToString(action);
-		if(!str)
+		if(action != CURL_POLL_NONE && action != CURL_POLL_IN && action != CURL_POLL_OUT && action != CURL_POLL_INOUT && action != CURL_POLL_REMOVE)
 		{
 			log_debug("socketFunction: unknown action: %d fd=%d", action, s);
 			return 0;
 		}
 
-		log_debug("socketFunction: %s %d", str, s);
+		log_debug("socketFunction: %s %d", socketActionToString(action), s);
+
+#ifdef Q_OS_LINUX
+		if(epollFd != -1)
+			return epollSocketFunction(s, action, socketp);
+#endif
 
 		if(action == CURL_POLL_REMOVE)
 		{
@@ -772,6 +1175,58 @@ public:
 		return 0;
 	}
 
+#ifdef Q_OS_LINUX
+	// sockets are registered level-triggered. curl doesn't always read or
+	//   write until EAGAIN, for example when a transfer pauses partway
+	//   through, so an edge-triggered registration could miss data that
+	//   is already waiting. socketp is only used to mark a socket as
+	//   registered
+	int epollSocketFunction(curl_socket_t s, int action, void *socketp)
+	{
+		if(action == CURL_POLL_REMOVE || action == CURL_POLL_NONE)
+		{
+			// unregister rather than keep an empty interest set, since
+			//   hangups are reported regardless and would spin
+			if(socketp)
+			{
+				epoll_ctl(epollFd, EPOLL_CTL_DEL, s, NULL);
+				curl_multi_assign(multi, s, NULL);
+			}
+
+			return 0;
+		}
+
+		struct epoll_event ev;
+		memset(&ev, 0, sizeof(ev));
+		if(action == CURL_POLL_IN || action == CURL_POLL_INOUT)
+			ev.events |= EPOLLIN;
+		if(action == CURL_POLL_OUT || action == CURL_POLL_INOUT)
+			ev.events |= EPOLLOUT;
+		ev.data.fd = s;
+
+		if(!socketp)
+		{
+			if(epoll_ctl(epollFd, EPOLL_CTL_ADD, s, &ev) == -1)
+			{
+				log_warning("epoll_ctl add failed for fd=%d", s);
+				return -1;
+			}
+
+			curl_multi_assign(multi, s, this);
+		}
+		else
+		{
+			if(epoll_ctl(epollFd, EPOLL_CTL_MOD, s, &ev) == -1)
+			{
+				log_warning("epoll_ctl mod failed for fd=%d", s);
+				return -1;
+			}
+		}
+
+		return 0;
+	}
+#endif
+
 	int timerFunction(CURLM *multi, long timeout_ms)
 	{
 		Q_UNUSED(multi);
@@ -809,11 +1264,14 @@ public:
 			if(!m || !m->msg)
 				break;
 
-			const char *str = msgToString(m->msg);
-			if(str)
-				log_debug("message: %s", str);
-			else
-				log_debug("unknown message: %d", m->msg);
+			if(log_outputLevel() >= LOG_LEVEL_DEBUG)
+			{
+				const char *str = msgToString(m->msg);
+				if(str)
+					log_debug("message: %s", str);
+				else
+					log_debug("unknown message: %d", m->msg);
+			}
 
 			if(m->msg == CURLMSG_DONE)
 			{
@@ -843,6 +1301,37 @@ public slots:
 		doSocketAction(false, socket, CURL_CSELECT_OUT);
 	}
 
+	void snEpoll_activated(int socket)
+	{
+		Q_UNUSED(socket);
+
+#ifdef Q_OS_LINUX
+		// anything beyond the batch is still ready and wakes us up again
+		//   in a later event loop iteration
+		struct epoll_event events[EPOLL_BATCH_SIZE];
+		int count = epoll_wait(epollFd, events, EPOLL_BATCH_SIZE, 0);
+
+		for(int n = 0; n < count; ++n)
+		{
+			int mask = 0;
+			if(events[n].events & (EPOLLIN | EPOLLHUP))
+				mask |= CURL_CSELECT_IN;
+			if(events[n].events & EPOLLOUT)
+				mask |= CURL_CSELECT_OUT;
+			if(events[n].events & EPOLLERR)
+				mask |= CURL_CSELECT_ERR;
+
+			// an earlier action may have closed this socket. curl
+			//   ignores sockets it doesn't know about
+			int running;
+			curl_multi_socket_action(multi, events[n].data.fd, mask, &running);
+		}
+
+		if(count > 0)
+			processMessages();
+#endif
+	}
+
 	void timer_timeout()
 	{
 		doSocketAction(false, CURL_SOCKET_TIMEOUT, 0);
@@ -852,11 +1341,13 @@ public slots:
 	{
 		pendingUpdate = false;
 
-#ifdef UNPAUSE_WORKAROUND
-		doSocketAction(true, 0, 0);
-#else
-		doSocketAction(false, CURL_SOCKET_TIMEOUT, 0);
-#endif
+		// with older curl, a walk of all transfers is the only way to
+		//   get unpaused ones going again. this costs O(connections) for
+		//   every unpause
+		if(g_targetedUnpause && curlSupportsTargetedUnpause())
+			doSocketAction(false, CURL_SOCKET_TIMEOUT, 0);
+		else
+			doSocketAction(true, 0, 0);
 	}
 };
 
@@ -883,17 +1374,33 @@ public:
 		}
 	};
 
+	static QMutex globalInitMutex;
+	static CURLSH *share;
+	static int shareRefs;
+
 	Item *current;
+	QList<CURL*> easyPool;
+	ConnectionAgeTracker ageTracker;
 	QHash<CurlConnectionManager*, Item*> old;
 	QTimer *timer;
 	int persistentConnectionMaxTime;
+	bool rollingRecycle;
 
-	CurlConnectionManagerManager(QObject *parent = 0) :
+	CurlConnectionManagerManager(int _persistentConnectionMaxTime, QObject *parent = 0) :
 		QObject(parent),
 		current(0),
-		persistentConnectionMaxTime(-1)
+		persistentConnectionMaxTime(_persistentConnectionMaxTime),
+		rollingRecycle(curlSupportsMaxLifetime())
 	{
-		curl_global_init(CURL_GLOBAL_ALL);
+		// curl_global_init is reference counted but not thread safe, and
+		//   there may be one of these per engine thread
+		{
+			QMutexLocker locker(&globalInitMutex);
+			curl_global_init(CURL_GLOBAL_ALL);
+
+			if(shareRefs++ == 0)
+				share = createShare();
+		}
 
 		timer = new QTimer(this);
 		connect(timer, &QTimer::timeout, this, &CurlConnectionManagerManager::rotate);
@@ -906,6 +1413,17 @@ public:
 		qDeleteAll(old);
 		delete current;
 
+		foreach(CURL *easy, easyPool)
+			curl_easy_cleanup(easy);
+
+		QMutexLocker locker(&globalInitMutex);
+
+		if(--shareRefs == 0)
+		{
+			curl_share_cleanup(share);
+			share = 0;
+		}
+
 		curl_global_cleanup();
 	}
 
@@ -916,7 +1434,7 @@ public:
 			current = new Item;
 			current->manager = new CurlConnectionManager(this);
 
-			if(persistentConnectionMaxTime > 0)
+			if(persistentConnectionMaxTime > 0 && !rollingRecycle)
 				timer->start(persistentConnectionMaxTime * 1000);
 		}
 
@@ -947,17 +1465,70 @@ public:
 		}
 	}
 
+	// handles are kept per thread rather than per connection manager, so
+	//   they survive manager rotation
+	CURL *takeEasy()
+	{
+		if(!easyPool.isEmpty())
+		{
+			Stats::add(Stats::EasyHandlesReused);
+			return easyPool.takeLast();
+		}
+
+		Stats::add(Stats::EasyHandlesCreated);
+		return curl_easy_init();
+	}
+
+	// the handle must have been removed from its multi handle
+	void recycleEasy(CURL *easy)
+	{
+		if(easyPool.count() >= EASY_POOL_MAX)
+		{
+			curl_easy_cleanup(easy);
+			return;
+		}
+
+		// clears all options, but keeps allocations and caches
+		curl_easy_reset(easy);
+		easyPool += easy;
+	}
+
 	void setPersistentConnectionMaxTime(int secs)
 	{
 		persistentConnectionMaxTime = secs;
 
-		if(persistentConnectionMaxTime > 0 && current)
+		if(persistentConnectionMaxTime > 0 && current && !rollingRecycle)
 			timer->start(persistentConnectionMaxTime * 1000);
 	}
 
-private slots:
+	// connections are retired individually once older than the max time,
+	//   less a jitter fixed per connection. must be called before the
+	//   handle is added to the multi handle
+	void applyConnectionMaxAge(CurlConnection *conn)
+	{
+#if LIBCURL_VERSION_NUM >= MAXLIFETIME_CONN_MIN_VERSION
+		if(rollingRecycle && persistentConnectionMaxTime > 0)
+		{
+			ageTracker.maxTime = persistentConnectionMaxTime;
+			conn->ageTracker = &ageTracker;
+
+			// sockets are closed through the callback of the handle that
+			//   opened them, which the tracker outlives
+			curl_easy_setopt(conn->easy, CURLOPT_CLOSESOCKETFUNCTION, ConnectionAgeTracker::closeSocket_cb);
+			curl_easy_setopt(conn->easy, CURLOPT_CLOSESOCKETDATA, &ageTracker);
+			curl_easy_setopt(conn->easy, CURLOPT_MAXLIFETIME_CONN, (long)persistentConnectionMaxTime);
+		}
+#else
+		Q_UNUSED(conn);
+#endif
+	}
+
+public slots:
 	void rotate()
 	{
+		if(!current)
+			return;
+
 		if(current->refs > 0)
 			old.insert(current->manager, current);
 		else
@@ -969,13 +1540,30 @@ private slots:
 	}
 };
 
+QMutex CurlConnectionManagerManager::globalInitMutex;
+CURLSH *CurlConnectionManagerManager::share = 0;
+int CurlConnectionManagerManager::shareRefs = 0;
+
+static int g_persistentConnectionMaxTime = -1;
+
 static CurlConnectionManagerManager *_g_ccmm = 0;
 
+// engine threads get their own manager, destroyed when the thread exits
+static QThreadStorage<CurlConnectionManagerManager*> g_threadCcmm;
+
 static CurlConnectionManagerManager *g_ccmm()
 {
-	if(!_g_ccmm)
-		_g_ccmm = new CurlConnectionManagerManager(QCoreApplication::instance());
-	return _g_ccmm;
+	QCoreApplication *app = QCoreApplication::instance();
+	if(!app || QThread::currentThread() == app->thread())
+	{
+		if(!_g_ccmm)
+			_g_ccmm = new CurlConnectionManagerManager(g_persistentConnectionMaxTime, app);
+		return _g_ccmm;
+	}
+
+	if(!g_threadCcmm.hasLocalData())
+		g_threadCcmm.setLocalData(new CurlConnectionManagerManager(g_persistentConnectionMaxTime));
+	return g_threadCcmm.localData();
 }
 
 class HttpRequest::Private : public QObject
@@ -989,6 +1577,8 @@ public:
 	bool trustConnectHost;
 	bool allowIPv6;
 	bool ignoreTlsErrors;
+	HttpRequest::HttpVersion httpVersion;
+	bool decodeContent;
 	int maxRedirects;
 	int addressesAttempted;
 	int addressesBlocked;
@@ -1009,6 +1599,8 @@ public:
 		trustConnectHost(false),
 		allowIPv6(false),
 		ignoreTlsErrors(false),
+		httpVersion(HttpRequest::DefaultHttpVersion),
+		decodeContent(true),
 		maxRedirects(-1),
 		addressesAttempted(0),
 		addressesBlocked(0),
@@ -1030,14 +1622,19 @@ public:
 	{
 		if(conn)
 		{
+			CurlConnectionManagerManager *ccmm = g_ccmm();
+
 			if(manager)
 			{
 				curl_multi_remove_handle(manager->multi, conn->easy);
 				manager->connections -= conn;
-				g_ccmm()->release(manager);
+				ccmm->release(manager);
 				manager = 0;
 			}
 
+			ccmm->recycleEasy(conn->easy);
+			conn->easy = 0;
+
 			delete conn;
 			conn = 0;
 		}
@@ -1099,7 +1696,7 @@ public:
 
 		assert(conn);
 
-		conn->out += body;
+		conn->out.append(body);
 
 		if(conn->pauseBits & CURLPAUSE_SEND)
 		{
@@ -1165,10 +1762,17 @@ public:
 	{
 		assert(!conn);
 
-		conn = new CurlConnection;
+		CurlConnectionManagerManager *ccmm = g_ccmm();
+
+		conn = new CurlConnection(ccmm->takeEasy());
 		connect(conn, &CurlConnection::nextAddress, this, &Private::conn_nextAddress);
 		connect(conn, &CurlConnection::updated, this, &Private::conn_updated);
 
+		// the client's accepted encodings, if the body is passed through
+		QByteArray acceptEncoding;
+		if(!decodeContent)
+			acceptEncoding = headers.get("Accept-Encoding");
+
 		// eat any transport headers as they'd likely break things
 		headers.removeAll("Connection");
 		headers.removeAll("Keep-Alive");
@@ -1180,6 +1784,10 @@ public:
 		conn->setupMethod(method, willWriteBody);
 
 		conn->setup(uri, headers, connectHost, connectPort, maxRedirects, trustConnectHost, allowIPv6);
+		conn->setHttpVersion(httpVersion);
+
+		if(!decodeContent)
+			conn->setPassthroughContent(acceptEncoding);
 
 		if(ignoreTlsErrors)
 		{
@@ -1191,7 +1799,9 @@ public:
 #endif
 		}
 
-		manager = g_ccmm()->retainCurrent();
+		manager = ccmm->retainCurrent();
+		ccmm->applyConnectionMaxAge(conn);
+		curl_easy_setopt(conn->easy, CURLOPT_SHARE, CurlConnectionManagerManager::share);
 		manager->connections += conn;
 		curl_multi_add_handle(manager->multi, conn->easy);
 
@@ -1313,6 +1923,16 @@ void HttpRequest::setAllowIPv6(bool on)
 	d->allowIPv6 = on;
 }
 
+void HttpRequest::setHttpVersion(HttpVersion version)
+{
+	d->httpVersion = version;
+}
+
+void HttpRequest::setDecodeContent(bool on)
+{
+	d->decodeContent = on;
+}
+
 void HttpRequest::start(const QString &method, const QUrl &uri, const HttpHeaders &headers, bool willWriteBody)
 {
 	d->start(method, uri, headers, willWriteBody);
@@ -1336,6 +1956,14 @@ int HttpRequest::bytesAvailable() const
 		return 0;
 }
 
+int HttpRequest::responseBufferCapacity() const
+{
+	if(d->conn)
+		return d->conn->guaranteedCapacity();
+	else
+		return 0;
+}
+
 bool HttpRequest::isFinished() const
 {
 	if(d->errorCondition != ErrorNone || (d->conn && d->conn->inFinished))
@@ -1349,6 +1977,22 @@ HttpRequest::ErrorCondition HttpRequest::errorCondition() const
 	return d->errorCondition;
 }
 
+HttpRequest::HttpVersion HttpRequest::negotiatedHttpVersion() const
+{
+	if(d->conn)
+		return d->conn->negotiatedHttpVersion();
+	else
+		return DefaultHttpVersion;
+}
+
+bool HttpRequest::connectionReused() const
+{
+	if(d->conn)
+		return d->conn->connectionReused();
+	else
+		return false;
+}
+
 int HttpRequest::responseCode() const
 {
 	if(d->conn)
@@ -1389,7 +2033,47 @@ void HttpRequest::blockAddress()
 
 void HttpRequest::setPersistentConnectionMaxTime(int secs)
 {
+	// applies to managers created later, such as those of engine threads
+	g_persistentConnectionMaxTime = secs;
+
 	g_ccmm()->setPersistentConnectionMaxTime(secs);
 }
 
+void HttpRequest::setMaxBufferSize(int size)
+{
+	g_maxBufferSize = size;
+}
+
+void HttpRequest::setMemoryBudget(qint64 bytes)
+{
+	ChunkBuffer::setMemoryBudget(bytes);
+}
+
+void HttpRequest::setTargetedUnpause(bool on)
+{
+	g_targetedUnpause = on;
+}
+
+void HttpRequest::setMaxConcurrentStreams(int max)
+{
+	g_maxConcurrentStreams = max;
+}
+
+void HttpRequest::setConnectionLimits(int perHost, int total)
+{
+	g_maxHostConnections = perHost;
+	g_maxTotalConnections = total;
+}
+
+void HttpRequest::setEventBackend(EventBackend backend)
+{
+	if(backend == g_eventBackend)
+		return;
+
+	g_eventBackend = backend;
+
+	// requests already started keep their manager until they finish
+	g_ccmm()->rotate();
+}
+
 #include "httprequest.moc"
@@ -52,6 +52,20 @@ public:
 		ErrorTooManyRedirects
 	};
 
+	enum HttpVersion
+	{
+		DefaultHttpVersion, // whatever libcurl prefers
+		Http1_1,
+		Http2, // negotiated with alpn, falling back to 1.1
+		Http2PriorKnowledge // cleartext http/2 without upgrade
+	};
+
+	enum EventBackend
+	{
+		QtEventBackend,
+		EpollEventBackend // linux only
+	};
+
 	HttpRequest(QObject *parent = 0);
 	~HttpRequest();
 
@@ -61,6 +75,17 @@ public:
 	void setFollowRedirects(int maxRedirects); // -1 to disable
 	void setAllowIPv6(bool on);
 
+	// with http/2, the request waits for an existing connection to the
+	//   host to confirm multiplexing before opening another
+	void setHttpVersion(HttpVersion version);
+
+	// on by default. if off, compressed response bodies are passed
+	//   through as received, with their content-encoding and
+	//   content-length headers. the encodings in the request's
+	//   Accept-Encoding header are advertised, or else all that libcurl
+	//   supports
+	void setDecodeContent(bool on);
+
 	void start(const QString &method, const QUrl &uri, const HttpHeaders &headers = HttpHeaders(), bool willWriteBody = true);
 
 	// may call this multiple times
@@ -69,6 +94,12 @@ public:
 	void endBody();
 
 	int bytesAvailable() const;
+
+	// how much of the response body is sure to be buffered before the
+	//   transfer pauses, at the buffer's current size. the buffer may
+	//   grow, but not if the memory budget is used up
+	int responseBufferCapacity() const;
+
 	bool isFinished() const;
 	ErrorCondition errorCondition() const;
 
@@ -76,6 +107,10 @@ public:
 	QByteArray responseReason() const;
 	HttpHeaders responseHeaders() const;
 
+	// valid once response headers are available
+	HttpVersion negotiatedHttpVersion() const;
+	bool connectionReused() const;
+
 	QByteArray readResponseBody(int size = -1); // takes from the buffer
 
 	// call in response to nextAddress() signal
@@ -83,6 +118,35 @@ public:
 
 	static void setPersistentConnectionMaxTime(int secs);
 
+	// receive buffers start small and grow up to this size (default
+	//   200000) for transfers whose reader falls behind
+	static void setMaxBufferSize(int size);
+
+	// limit on the total memory of receive buffers across all threads,
+	//   including pooled chunks and chunks still referenced by responses,
+	//   0 (default) for no limit. when reached, buffers stop growing and
+	//   transfers pause sooner
+	static void setMemoryBudget(qint64 bytes);
+
+	// on by default. if off, or if libcurl is older than 7.68.0, every
+	//   unpause drives all transfers of the thread rather than only the
+	//   unpaused one
+	static void setTargetedUnpause(bool on);
+
+	// limit of concurrent streams per http/2 connection, for connection
+	//   managers created afterwards. 0 for the libcurl default
+	static void setMaxConcurrentStreams(int max);
+
+	// limits on connections per host and in total, per connection
+	//   manager (engine thread), for managers created afterwards. 0 for
+	//   no limit
+	static void setConnectionLimits(int perHost, int total);
+
+	// applies to connection managers created afterwards. the calling
+	//   thread's manager is replaced, and requests already started keep
+	//   the old one until they finish
+	static void setEventBackend(EventBackend backend);
+
 signals:
 	// NOTE: not DOR-SS
 	void nextAddress(const QHostAddress &addr);
@@ -44,8 +44,33 @@ SOURCES += \
 	$$SRC_DIR/websocket.cpp
 
 HEADERS += \
+	$$SRC_DIR/logutil.h \
+	$$SRC_DIR/accesslog.h \
+	$$SRC_DIR/accesspolicy.h \
+	$$SRC_DIR/bodybuffer.h \
+	$$SRC_DIR/chunkbuffer.h \
+	$$SRC_DIR/connectionwarmer.h \
+	$$SRC_DIR/headerparser.h \
+	$$SRC_DIR/hostlimiter.h \
 	$$SRC_DIR/appconfig.h \
-	$$SRC_DIR/worker.h
+	$$SRC_DIR/packetcoalescer.h \
+	$$SRC_DIR/stats.h \
+	$$SRC_DIR/timerwheel.h \
+	$$SRC_DIR/worker.h \
+	$$SRC_DIR/zhttpcodec.h \
+	$$SRC_DIR/zmqpublisher.h
 
 SOURCES += \
-	$$SRC_DIR/worker.cpp
+	$$SRC_DIR/accesslog.cpp \
+	$$SRC_DIR/accesspolicy.cpp \
+	$$SRC_DIR/bodybuffer.cpp \
+	$$SRC_DIR/chunkbuffer.cpp \
+	$$SRC_DIR/connectionwarmer.cpp \
+	$$SRC_DIR/headerparser.cpp \
+	$$SRC_DIR/hostlimiter.cpp \
+	$$SRC_DIR/packetcoalescer.cpp \
+	$$SRC_DIR/stats.cpp \
+	$$SRC_DIR/timerwheel.cpp \
+	$$SRC_DIR/worker.cpp \
+	$$SRC_DIR/zhttpcodec.cpp \
+	$$SRC_DIR/zmqpublisher.cpp
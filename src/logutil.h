@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) 2026 Fanout, Inc.
+ *
+ * This file is part of Zurl.
+ *
+ * $FANOUT_BEGIN_LICENSE:GPL$
+ *
+ * Zurl is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zurl is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Zurl may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#ifndef LOGUTIL_H
+#define LOGUTIL_H
+
+#include "log.h"
+
+// wrap the log functions so arguments are only evaluated if the message
+//   will be written. the functions themselves check the level too, but
+//   by then any formatting work in the arguments has already been done.
+//   a function-like macro doesn't expand within itself, so the inner
+//   calls go to the real functions
+
+#define log_warning(...) \
+	do { if(log_outputLevel() >= LOG_LEVEL_WARNING) log_warning(__VA_ARGS__); } while(0)
+
+#define log_info(...) \
+	do { if(log_outputLevel() >= LOG_LEVEL_INFO) log_info(__VA_ARGS__); } while(0)
+
+#define log_debug(...) \
+	do { if(log_outputLevel() >= LOG_LEVEL_DEBUG) log_debug(__VA_ARGS__); } while(0)
+
+#endif
@@ -0,0 +1,223 @@
+/*
+ * Copyright (C) 2026 Fanout, Inc.
+ *
+ * This file is part of Zurl.
+ *
+ * $FANOUT_BEGIN_LICENSE:GPL$
+ *
+ * Zurl is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zurl is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Zurl may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#include "packetcoalescer.h"
+
+#include <QTimer>
+#include <QHash>
+#include <QPointer>
+#include "zhttpresponsepacket.h"
+#include "logutil.h"
+#include "appconfig.h"
+
+// keep packets well within typical message size limits
+#define MAX_IDS_PER_PACKET 1000
+
+class CoalesceKey
+{
+public:
+	Worker::Format format;
+	QByteArray receiver;
+	int credits;
+
+	bool operator==(const CoalesceKey &other) const
+	{
+		return (format == other.format && receiver == other.receiver && credits == other.credits);
+	}
+};
+
+static uint qHash(const CoalesceKey &key, uint seed = 0)
+{
+	return qHash(key.receiver, seed) ^ qHash((int)key.format, seed) ^ qHash(key.credits, seed);
+}
+
+class PacketCoalescer::Private : public QObject
+{
+	Q_OBJECT
+
+public:
+	class Pending
+	{
+	public:
+		Worker::Format format;
+		QByteArray receiver;
+		int credits;
+		std::function<int ()> nextSeq;
+	};
+
+	PacketCoalescer *q;
+	AppConfig *config;
+	QTimer *timer;
+	QHash<QByteArray, Pending> pendingByRid;
+
+	Private(PacketCoalescer *_q, AppConfig *_config, int interval) :
+		QObject(_q),
+		q(_q),
+		config(_config)
+	{
+		timer = new QTimer(this);
+		connect(timer, &QTimer::timeout, this, &Private::timer_timeout);
+		timer->setSingleShot(true);
+		timer->setInterval(interval);
+	}
+
+	void add(Worker::Format format, const QByteArray &receiver, const QByteArray &rid, int credits, const std::function<int ()> &nextSeq)
+	{
+		QHash<QByteArray, Pending>::iterator it = pendingByRid.find(rid);
+		if(it != pendingByRid.end())
+		{
+			// credits add up, and a keep-alive adds nothing to a
+			//   pending packet
+			it.value().credits += credits;
+			return;
+		}
+
+		Pending p;
+		p.format = format;
+		p.receiver = receiver;
+		p.credits = credits;
+		p.nextSeq = nextSeq;
+		pendingByRid.insert(rid, p);
+
+		if(!timer->isActive())
+			timer->start();
+	}
+
+	ZhttpResponsePacket makePacket(int credits)
+	{
+		ZhttpResponsePacket out;
+		out.from = config->clientId;
+		if(credits > 0)
+		{
+			out.type = ZhttpResponsePacket::Credit;
+			out.credits = credits;
+		}
+		else
+			out.type = ZhttpResponsePacket::KeepAlive;
+		out.multi = true;
+		return out;
+	}
+
+	void flush(const QByteArray &rid)
+	{
+		QHash<QByteArray, Pending>::iterator it = pendingByRid.find(rid);
+		if(it == pendingByRid.end())
+			return;
+
+		Pending p = it.value();
+		pendingByRid.erase(it);
+
+		ZhttpResponsePacket out = makePacket(p.credits);
+		out.ids += ZhttpResponsePacket::Id(rid, p.nextSeq());
+
+		emit q->readyRead(p.format, p.receiver, out);
+	}
+
+	void flushAll()
+	{
+		QHash<CoalesceKey, QList<ZhttpResponsePacket::Id> > groups;
+
+		QHashIterator<QByteArray, Pending> it(pendingByRid);
+		while(it.hasNext())
+		{
+			it.next();
+			const Pending &p = it.value();
+
+			CoalesceKey key;
+			key.format = p.format;
+			key.receiver = p.receiver;
+			key.credits = p.credits;
+
+			groups[key] += ZhttpResponsePacket::Id(it.key(), p.nextSeq());
+		}
+
+		int count = pendingByRid.count();
+		pendingByRid.clear();
+
+		QPointer<QObject> self = this;
+
+		QHashIterator<CoalesceKey, QList<ZhttpResponsePacket::Id> > git(groups);
+		while(git.hasNext())
+		{
+			git.next();
+			const CoalesceKey &key = git.key();
+			const QList<ZhttpResponsePacket::Id> &ids = git.value();
+
+			for(int n = 0; n < ids.count(); n += MAX_IDS_PER_PACKET)
+			{
+				ZhttpResponsePacket out = makePacket(key.credits);
+				out.ids = ids.mid(n, MAX_IDS_PER_PACKET);
+
+				emit q->readyRead(key.format, key.receiver, out);
+				if(!self)
+					return;
+			}
+		}
+
+		log_debug("coalesced %d session packets into %d groups", count, groups.count());
+	}
+
+private slots:
+	void timer_timeout()
+	{
+		flushAll();
+	}
+};
+
+PacketCoalescer::PacketCoalescer(AppConfig *config, int interval, QObject *parent) :
+	QObject(parent)
+{
+	d = new Private(this, config, interval);
+}
+
+PacketCoalescer::~PacketCoalescer()
+{
+	delete d;
+}
+
+void PacketCoalescer::add(Worker::Format format, const QByteArray &receiver, const QByteArray &rid, int credits, const std::function<int ()> &nextSeq)
+{
+	d->add(format, receiver, rid, credits, nextSeq);
+}
+
+bool PacketCoalescer::hasPending(const QByteArray &rid) const
+{
+	return d->pendingByRid.contains(rid);
+}
+
+void PacketCoalescer::flush(const QByteArray &rid)
+{
+	d->flush(rid);
+}
+
+void PacketCoalescer::remove(const QByteArray &rid)
+{
+	d->pendingByRid.remove(rid);
+}
+
+#include "packetcoalescer.moc"
@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2026 Fanout, Inc.
+ *
+ * This file is part of Zurl.
+ *
+ * $FANOUT_BEGIN_LICENSE:GPL$
+ *
+ * Zurl is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zurl is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Zurl may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#ifndef PACKETCOALESCER_H
+#define PACKETCOALESCER_H
+
+#include <functional>
+#include <QObject>
+#include "worker.h"
+
+class AppConfig;
+class ZhttpResponsePacket;
+
+// collects keep-alive and credit packets from stream sessions and sends
+//   them as multi-id packets, one per receiver (and credit amount), each
+//   flush interval. sequence numbers are assigned at flush time, so a
+//   session must call flush() before sending anything else, and remove()
+//   when it stops
+
+class PacketCoalescer : public QObject
+{
+	Q_OBJECT
+
+public:
+	PacketCoalescer(AppConfig *config, int interval, QObject *parent = 0);
+	~PacketCoalescer();
+
+	// credits of 0 means a keep-alive. nextSeq is called once when the
+	//   packet is sent, and must return the session's next sequence number
+	void add(Worker::Format format, const QByteArray &receiver, const QByteArray &rid, int credits, const std::function<int ()> &nextSeq);
+
+	bool hasPending(const QByteArray &rid) const;
+
+	// send anything pending for the session now, on its own
+	void flush(const QByteArray &rid);
+
+	void remove(const QByteArray &rid);
+
+signals:
+	void readyRead(Worker::Format format, const QByteArray &receiver, const ZhttpResponsePacket &response);
+
+private:
+	class Private;
+	friend class Private;
+	Private *d;
+};
+
+#endif
@@ -0,0 +1,318 @@
+/*
+ * Copyright (C) 2026 Fanout, Inc.
+ *
+ * This file is part of Zurl.
+ *
+ * $FANOUT_BEGIN_LICENSE:GPL$
+ *
+ * Zurl is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zurl is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Zurl may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#include "stats.h"
+
+#include <string.h>
+#include <atomic>
+#include <QList>
+#include <QMutex>
+
+// histogram buckets are log-linear: values below 16 get a bucket each,
+//   and above that each power of two is split into 8 buckets, for about
+//   12% precision. values are clamped at 2^40 (about 13 days in usecs)
+#define SUB_BITS 3
+#define SUB_COUNT (1 << SUB_BITS)
+#define LINEAR_MAX (SUB_COUNT * 2)
+#define MAX_EXP 40
+#define BUCKET_COUNT (LINEAR_MAX + (MAX_EXP - SUB_BITS) * SUB_COUNT)
+
+static const char *counterNames[Stats::CounterCount] =
+{
+	"workers-http-single",
+	"workers-http-stream",
+	"workers-websocket",
+	"requests-started",
+	"bytes-in",
+	"bytes-out",
+	"body-bytes-copied",
+	"body-bytes-shared",
+	"valve-closed-ms",
+	"in-batches",
+	"in-messages",
+	"in-stream-batches",
+	"in-stream-messages",
+	"in-req-batches",
+	"in-req-messages",
+	"buffer-bytes-reserved",
+	"buffer-grow-denied",
+	"tls-handshakes",
+	"tls-sessions-resumed",
+	"connections-opened",
+	"connections-reused",
+	"http2-requests",
+	"easy-handles-created",
+	"easy-handles-reused",
+	"host-queue-depth",
+	"host-queue-rejected",
+	"error-bad-request",
+	"error-policy-violation",
+	"error-remote-connection-failed",
+	"error-tls-error",
+	"error-connection-timeout",
+	"error-content-not-allowed",
+	"error-too-many-redirects",
+	"error-rejected",
+	"error-frame-too-large",
+	"error-max-size-exceeded",
+	"error-session-timeout",
+	"error-other"
+};
+
+static const char *histogramNames[Stats::HistogramCount] =
+{
+	"dns-time",
+	"connect-time",
+	"tls-time",
+	"first-byte-time",
+	"total-time",
+	"host-queue-wait-time"
+};
+
+static const struct
+{
+	const char *condition;
+	Stats::Counter counter;
+} errorCounters[] =
+{
+	{ "bad-request", Stats::ErrorBadRequest },
+	{ "policy-violation", Stats::ErrorPolicyViolation },
+	{ "remote-connection-failed", Stats::ErrorRemoteConnectionFailed },
+	{ "tls-error", Stats::ErrorTls },
+	{ "connection-timeout", Stats::ErrorConnectionTimeout },
+	{ "content-not-allowed", Stats::ErrorContentNotAllowed },
+	{ "too-many-redirects", Stats::ErrorTooManyRedirects },
+	{ "rejected", Stats::ErrorRejected },
+	{ "frame-too-large", Stats::ErrorFrameTooLarge },
+	{ "max-size-exceeded", Stats::ErrorMaxSizeExceeded },
+	{ "session-timeout", Stats::ErrorSessionTimeout },
+	{ 0, Stats::ErrorOther }
+};
+
+static int bucketIndex(qint64 v)
+{
+	if(v < 0)
+		v = 0;
+
+	if(v < LINEAR_MAX)
+		return (int)v;
+
+	int e = 63 - __builtin_clzll((quint64)v);
+	if(e > MAX_EXP)
+		return BUCKET_COUNT - 1;
+
+	return LINEAR_MAX + (e - SUB_BITS - 1) * SUB_COUNT + (int)((v >> (e - SUB_BITS)) & (SUB_COUNT - 1));
+}
+
+static qint64 bucketLowerBound(int index)
+{
+	if(index < LINEAR_MAX)
+		return index;
+
+	int e = (index - LINEAR_MAX) / SUB_COUNT + SUB_BITS + 1;
+	int sub = (index - LINEAR_MAX) % SUB_COUNT;
+	return ((qint64)(SUB_COUNT + sub)) << (e - SUB_BITS);
+}
+
+static qint64 bucketUpperBound(int index)
+{
+	if(index < LINEAR_MAX)
+		return index;
+
+	int e = (index - LINEAR_MAX) / SUB_COUNT + SUB_BITS + 1;
+	return bucketLowerBound(index) + ((qint64)1 << (e - SUB_BITS)) - 1;
+}
+
+namespace {
+
+// only the owning thread writes, so plain load/store is enough and
+//   avoids locked instructions
+inline void increment(std::atomic<qint64> &x, qint64 value)
+{
+	x.store(x.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+class HistogramData
+{
+public:
+	std::atomic<qint64> buckets[BUCKET_COUNT];
+	std::atomic<qint64> count;
+	std::atomic<qint64> sum;
+	std::atomic<qint64> max;
+
+	HistogramData() :
+		count(0),
+		sum(0),
+		max(0)
+	{
+		for(int n = 0; n < BUCKET_COUNT; ++n)
+			buckets[n].store(0, std::memory_order_relaxed);
+	}
+};
+
+class Block
+{
+public:
+	std::atomic<qint64> counters[Stats::CounterCount];
+	HistogramData histograms[Stats::HistogramCount];
+
+	Block()
+	{
+		for(int n = 0; n < Stats::CounterCount; ++n)
+			counters[n].store(0, std::memory_order_relaxed);
+	}
+};
+
+}
+
+// blocks are never freed, so that counts from finished threads are kept
+static QMutex g_blocksMutex;
+static QList<Block*> g_blocks;
+static thread_local Block *t_block = 0;
+
+static Block *localBlock()
+{
+	if(!t_block)
+	{
+		t_block = new Block;
+
+		QMutexLocker locker(&g_blocksMutex);
+		g_blocks += t_block;
+	}
+
+	return t_block;
+}
+
+void Stats::add(Counter c, qint64 value)
+{
+	increment(localBlock()->counters[c], value);
+}
+
+void Stats::record(Histogram h, qint64 usecs)
+{
+	HistogramData &d = localBlock()->histograms[h];
+
+	increment(d.buckets[bucketIndex(usecs)], 1);
+	increment(d.count, 1);
+	increment(d.sum, usecs);
+	if(usecs > d.max.load(std::memory_order_relaxed))
+		d.max.store(usecs, std::memory_order_relaxed);
+}
+
+void Stats::addError(const QByteArray &condition)
+{
+	int n = 0;
+	for(; errorCounters[n].condition; ++n)
+	{
+		if(condition == errorCounters[n].condition)
+			break;
+	}
+
+	add(errorCounters[n].counter);
+}
+
+static qint64 percentile(const qint64 *buckets, qint64 count, int pct)
+{
+	qint64 target = (count * pct + 99) / 100;
+	qint64 seen = 0;
+	for(int n = 0; n < BUCKET_COUNT; ++n)
+	{
+		seen += buckets[n];
+		if(seen >= target)
+			return bucketUpperBound(n);
+	}
+
+	return 0;
+}
+
+QVariant Stats::snapshot()
+{
+	QList<Block*> blocks;
+	{
+		QMutexLocker locker(&g_blocksMutex);
+		blocks = g_blocks;
+	}
+
+	QVariantHash counters;
+	for(int c = 0; c < CounterCount; ++c)
+	{
+		qint64 total = 0;
+		foreach(Block *b, blocks)
+			total += b->counters[c].load(std::memory_order_relaxed);
+
+		counters[counterNames[c]] = total;
+	}
+
+	QVariantHash histograms;
+	for(int h = 0; h < HistogramCount; ++h)
+	{
+		qint64 buckets[BUCKET_COUNT];
+		memset(buckets, 0, sizeof(buckets));
+		qint64 count = 0;
+		qint64 sum = 0;
+		qint64 max = 0;
+
+		foreach(Block *b, blocks)
+		{
+			const HistogramData &d = b->histograms[h];
+			for(int n = 0; n < BUCKET_COUNT; ++n)
+				buckets[n] += d.buckets[n].load(std::memory_order_relaxed);
+			count += d.count.load(std::memory_order_relaxed);
+			sum += d.sum.load(std::memory_order_relaxed);
+			max = qMax(max, d.max.load(std::memory_order_relaxed));
+		}
+
+		QVariantHash vh;
+		vh["count"] = count;
+		vh["sum"] = sum;
+		vh["max"] = max;
+
+		if(count > 0)
+		{
+			vh["p50"] = percentile(buckets, count, 50);
+			vh["p90"] = percentile(buckets, count, 90);
+			vh["p99"] = percentile(buckets, count, 99);
+
+			// non-empty buckets as [lower bound, count] pairs
+			QVariantList vbuckets;
+			for(int n = 0; n < BUCKET_COUNT; ++n)
+			{
+				if(buckets[n] > 0)
+					vbuckets += QVariant(QVariantList() << bucketLowerBound(n) << buckets[n]);
+			}
+			vh["buckets"] = vbuckets;
+		}
+
+		histograms[histogramNames[h]] = vh;
+	}
+
+	QVariantHash out;
+	out["counters"] = counters;
+	out["histograms"] = histograms;
+	return out;
+}
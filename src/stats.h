@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2026 Fanout, Inc.
+ *
+ * This file is part of Zurl.
+ *
+ * $FANOUT_BEGIN_LICENSE:GPL$
+ *
+ * Zurl is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zurl is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Zurl may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <QVariant>
+
+// process-wide counters and latency histograms. each thread updates its
+//   own block of relaxed atomics, so recording never locks or contends.
+//   snapshot() sums the blocks of all threads
+
+class Stats
+{
+public:
+	enum Counter
+	{
+		// gauges, added to and subtracted from
+		WorkersHttpSingle,
+		WorkersHttpStream,
+		WorkersWebSocket,
+
+		RequestsStarted,
+		BytesIn, // request body bytes received from clients
+		BytesOut, // response body bytes sent to clients
+		BodyBytesCopied, // response body bytes copied out of receive buffers
+		BodyBytesShared, // response body bytes handed off without copying
+		ValveClosedMsecs,
+		InBatches, // reads of in_spec, for average batch size
+		InMessages,
+		InStreamBatches,
+		InStreamMessages,
+		InReqBatches,
+		InReqMessages,
+		BufferBytesReserved, // gauge
+		BufferGrowDenied,
+		TlsHandshakes, // new tls connections
+		TlsSessionsResumed, // of those, how many resumed a session
+		ConnectionsOpened, // requests that opened a new connection
+		ConnectionsReused, // requests that used an existing connection
+		Http2Requests,
+		EasyHandlesCreated,
+		EasyHandlesReused,
+		HostQueueDepth, // gauge, requests waiting for a per-host slot
+		HostQueueRejected,
+
+		ErrorBadRequest,
+		ErrorPolicyViolation,
+		ErrorRemoteConnectionFailed,
+		ErrorTls,
+		ErrorConnectionTimeout,
+		ErrorContentNotAllowed,
+		ErrorTooManyRedirects,
+		ErrorRejected,
+		ErrorFrameTooLarge,
+		ErrorMaxSizeExceeded,
+		ErrorSessionTimeout,
+		ErrorOther,
+
+		CounterCount
+	};
+
+	enum Histogram
+	{
+		// curl transfer phases, in microseconds
+		DnsTime,
+		ConnectTime,
+		TlsTime,
+		FirstByteTime,
+		TotalTime,
+
+		HostQueueWaitTime,
+
+		HistogramCount
+	};
+
+	static void add(Counter c, qint64 value = 1);
+	static void record(Histogram h, qint64 usecs);
+
+	// maps an error condition string to its counter
+	static void addError(const QByteArray &condition);
+
+	// hash of counters and histograms, keyed by name. byte arrays for
+	//   strings, suitable for tnetstring encoding
+	static QVariant snapshot();
+};
+
+#endif
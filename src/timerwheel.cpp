@@ -0,0 +1,315 @@
+/*
+ * Copyright (C) 2026 Fanout, Inc.
+ *
+ * This file is part of Zurl.
+ *
+ * $FANOUT_BEGIN_LICENSE:GPL$
+ *
+ * Zurl is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zurl is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Zurl may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#include "timerwheel.h"
+
+#include <string.h>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QThreadStorage>
+
+// 4 levels of 256 slots at 10ms per tick covers about 497 days. anything
+//   further out is parked in the last level and re-sorted as it cascades
+#define LEVEL_BITS 8
+#define LEVELS 4
+#define SLOTS (1 << LEVEL_BITS)
+#define SLOT_MASK (SLOTS - 1)
+
+class TimerWheel::Private : public QObject
+{
+	Q_OBJECT
+
+public:
+	TimerWheel *q;
+	QTimer *timer;
+	QElapsedTimer clock;
+	WheelTimer *slots[LEVELS][SLOTS];
+	qint64 currentTick;
+	qint64 wakeTick; // when the timer is set to fire, if active
+	int count;
+
+	Private(TimerWheel *_q) :
+		q(_q),
+		currentTick(0),
+		wakeTick(0),
+		count(0)
+	{
+		memset(slots, 0, sizeof(slots));
+
+		timer = new QTimer(this);
+		connect(timer, &QTimer::timeout, this, &Private::timer_timeout);
+		timer->setSingleShot(true);
+
+		clock.start();
+	}
+
+	qint64 nowTick() const
+	{
+		return clock.elapsed() / TickMsecs;
+	}
+
+	// the first tick with something to do: a non-empty slot in the finest
+	//   level, or the next time the finest level wraps, since timers may
+	//   cascade down then
+	qint64 nextWakeTick() const
+	{
+		qint64 boundary = (currentTick | SLOT_MASK) + 1;
+		for(qint64 tick = currentTick + 1; tick < boundary; ++tick)
+		{
+			if(slots[0][tick & SLOT_MASK])
+				return tick;
+		}
+
+		return boundary;
+	}
+
+	// the QTimer only fires when there is something to do, so idle timers
+	//   far in the future don't wake the thread every tick
+	void schedule()
+	{
+		if(count == 0)
+		{
+			timer->stop();
+			return;
+		}
+
+		wakeTick = nextWakeTick();
+		timer->start(qMax(wakeTick * TickMsecs - clock.elapsed(), (qint64)0));
+	}
+
+	void link(WheelTimer *t)
+	{
+		qint64 delta = t->expires_ - currentTick;
+
+		int level = 0;
+		qint64 pos = t->expires_;
+		if(delta <= 0)
+		{
+			// due now. this only happens while cascading, in which case
+			//   the current slot is about to be processed
+			pos = currentTick;
+		}
+		else
+		{
+			while(level < LEVELS - 1 && delta >= ((qint64)1 << (LEVEL_BITS * (level + 1))))
+				++level;
+
+			// too far out for the wheel. park it in the furthest slot
+			if(level == LEVELS - 1 && delta >= ((qint64)1 << (LEVEL_BITS * LEVELS)))
+				pos = currentTick + ((qint64)1 << (LEVEL_BITS * LEVELS)) - 1;
+		}
+
+		WheelTimer **head = &slots[level][(pos >> (LEVEL_BITS * level)) & SLOT_MASK];
+
+		t->next_ = *head;
+		if(t->next_)
+			t->next_->pprev_ = &t->next_;
+		t->pprev_ = head;
+		*head = t;
+	}
+
+	void unlink(WheelTimer *t)
+	{
+		*(t->pprev_) = t->next_;
+		if(t->next_)
+			t->next_->pprev_ = t->pprev_;
+
+		t->next_ = 0;
+		t->pprev_ = 0;
+	}
+
+	void add(WheelTimer *t, int msecs)
+	{
+		if(t->pprev_)
+		{
+			unlink(t);
+		}
+		else
+		{
+			// the wheel isn't advanced while idle. catch up now, since
+			//   every slot is empty, rather than walk all the missed
+			//   ticks on the next advance
+			if(count == 0)
+				currentTick = qMax(currentTick, nowTick());
+
+			++count;
+		}
+
+		// round up, and always wait at least one tick
+		qint64 ticks = qMax(((qint64)msecs + TickMsecs - 1) / TickMsecs, (qint64)1);
+		t->expires_ = qMax(currentTick, nowTick()) + ticks;
+
+		link(t);
+
+		if(!timer->isActive() || t->expires_ < wakeTick)
+			schedule();
+	}
+
+	void remove(WheelTimer *t)
+	{
+		if(!t->pprev_)
+			return;
+
+		unlink(t);
+		--count;
+	}
+
+	void cascade(int level)
+	{
+		WheelTimer **head = &slots[level][(currentTick >> (LEVEL_BITS * level)) & SLOT_MASK];
+
+		WheelTimer *list = *head;
+		*head = 0;
+
+		while(list)
+		{
+			WheelTimer *t = list;
+			list = t->next_;
+
+			t->next_ = 0;
+			t->pprev_ = 0;
+			link(t);
+		}
+	}
+
+	void advance(qint64 tick)
+	{
+		while(currentTick < tick && count > 0)
+		{
+			++currentTick;
+
+			// when a level wraps, pull the next slot of the level above
+			//   down into the finer levels
+			for(int level = 1; level < LEVELS; ++level)
+			{
+				if(((currentTick >> (LEVEL_BITS * (level - 1))) & SLOT_MASK) != 0)
+					break;
+
+				cascade(level);
+			}
+
+			WheelTimer **head = &slots[0][currentTick & SLOT_MASK];
+			while(*head)
+			{
+				WheelTimer *t = *head;
+				unlink(t);
+				--count;
+
+				// copy, since the callback may delete the timer
+				std::function<void ()> callback = t->callback_;
+				if(callback)
+					callback();
+			}
+		}
+
+		// nothing pending, so jump ahead rather than walk the empty ticks
+		//   next time
+		if(count == 0 && currentTick < tick)
+			currentTick = tick;
+
+		schedule();
+	}
+
+private slots:
+	void timer_timeout()
+	{
+		advance(nowTick());
+	}
+};
+
+static QThreadStorage<TimerWheel*> g_wheels;
+
+WheelTimer::WheelTimer(TimerWheel *wheel) :
+	wheel_(wheel),
+	next_(0),
+	pprev_(0),
+	expires_(0)
+{
+	if(!wheel_)
+		wheel_ = TimerWheel::instance();
+}
+
+WheelTimer::~WheelTimer()
+{
+	stop();
+}
+
+void WheelTimer::setCallback(const std::function<void ()> &callback)
+{
+	callback_ = callback;
+}
+
+bool WheelTimer::isActive() const
+{
+	return (pprev_ != 0);
+}
+
+void WheelTimer::start(int msecs)
+{
+	wheel_->d->add(this, msecs);
+}
+
+void WheelTimer::stop()
+{
+	wheel_->d->remove(this);
+}
+
+TimerWheel::TimerWheel()
+{
+	d = new Private(this);
+}
+
+TimerWheel::~TimerWheel()
+{
+	delete d;
+}
+
+TimerWheel *TimerWheel::instance()
+{
+	if(!g_wheels.hasLocalData())
+		g_wheels.setLocalData(new TimerWheel);
+
+	return g_wheels.localData();
+}
+
+int TimerWheel::count() const
+{
+	return d->count;
+}
+
+qint64 TimerWheel::currentTick() const
+{
+	return d->currentTick;
+}
+
+void TimerWheel::advance(qint64 tick)
+{
+	d->advance(tick);
+}
+
+#include "timerwheel.moc"
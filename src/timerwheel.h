@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2026 Fanout, Inc.
+ *
+ * This file is part of Zurl.
+ *
+ * $FANOUT_BEGIN_LICENSE:GPL$
+ *
+ * Zurl is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zurl is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Zurl may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include <functional>
+#include <QtGlobal>
+
+// a hierarchical timing wheel, for large numbers of mostly idle timeouts.
+//   arming, re-arming, and cancelling a timer are O(1), and the wheel
+//   needs only a single QTimer, which is armed for the next due slot (or
+//   at most every 256 ticks while only far timers are pending), rather
+//   than ticking. resolution is TickMsecs. each thread has its own wheel, which lives
+//   until the thread exits. timers must not outlive their wheel
+
+class TimerWheel;
+
+class WheelTimer
+{
+public:
+	// if wheel is null, the wheel for the current thread is used
+	WheelTimer(TimerWheel *wheel = 0);
+	~WheelTimer();
+
+	void setCallback(const std::function<void ()> &callback);
+
+	bool isActive() const;
+
+	// single shot. restarting an active timer re-arms it
+	void start(int msecs);
+	void stop();
+
+private:
+	Q_DISABLE_COPY(WheelTimer)
+
+	friend class TimerWheel;
+	TimerWheel *wheel_;
+	WheelTimer *next_;
+	WheelTimer **pprev_;
+	qint64 expires_;
+	std::function<void ()> callback_;
+};
+
+class TimerWheel
+{
+public:
+	enum { TickMsecs = 10 };
+
+	TimerWheel();
+	~TimerWheel();
+
+	static TimerWheel *instance();
+
+	int count() const;
+	qint64 currentTick() const;
+
+	// fire all timers due up to and including tick. this is called
+	//   automatically from the event loop, but may also be called directly
+	void advance(qint64 tick);
+
+private:
+	Q_DISABLE_COPY(TimerWheel)
+
+	class Private;
+	friend class Private;
+	friend class WheelTimer;
+	Private *d;
+};
+
+#endif
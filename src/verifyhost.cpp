@@ -35,7 +35,7 @@ in this Software without prior written authorization of the copyright holder.
 #include <arpa/inet.h>
 #include <openssl/crypto.h>
 #include <openssl/x509.h>
-#include "log.h"
+#include "logutil.h"
 
 #define DEBUGASSERT(x) assert(x)
 
@@ -35,13 +35,18 @@
 #include <QUrl>
 #include <QPointer>
 #include <QRandomGenerator>
+#include <QTimer>
 #include <QSslSocket>
-#include "log.h"
+#include "logutil.h"
 #include "bufferlist.h"
 #include "addressresolver.h"
 #include "verifyhost.h"
 
 #define RESPONSE_BODY_MAX 100000
+
+// delay before racing the next address against pending connection
+//   attempts (rfc 8305)
+#define CONNECT_ATTEMPT_DELAY 250
 #define MAGIC_STRING "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
 
 static quint16 read16(const quint8 *in)
@@ -336,9 +341,12 @@ public:
 	QString connectHost;
 	bool trustConnectHost;
 	bool ignoreTlsErrors;
+	bool allowIPv6;
 	int maxRedirects;
 	int maxFrameSize;
 	QSslSocket *sock;
+	QList<QSslSocket*> attempts; // racing to connect, before sock is chosen
+	QTimer *attemptTimer;
 	QUrl requestUri;
 	HttpHeaders requestHeaders;
 	QByteArray requestKey;
@@ -370,6 +378,7 @@ public:
 		state(Idle),
 		trustConnectHost(false),
 		ignoreTlsErrors(false),
+		allowIPv6(false),
 		maxRedirects(-1),
 		maxFrameSize(-1),
 		sock(0),
@@ -389,6 +398,10 @@ public:
 		resolver = new AddressResolver(this);
 		connect(resolver, &AddressResolver::resultsReady, this, &Private::resolver_resultsReady);
 		connect(resolver, &AddressResolver::error, this, &Private::resolver_error);
+
+		attemptTimer = new QTimer(this);
+		connect(attemptTimer, &QTimer::timeout, this, &Private::tryNextAddress);
+		attemptTimer->setSingleShot(true);
 	}
 
 	~Private()
@@ -398,6 +411,8 @@ public:
 
 	void cleanup()
 	{
+		cancelAttempts();
+
 		if(sock)
 		{
 			sock->disconnect(this);
@@ -407,6 +422,34 @@ public:
 		}
 	}
 
+	void cancelAttempts()
+	{
+		attemptTimer->stop();
+
+		foreach(QSslSocket *s, attempts)
+		{
+			s->disconnect(this);
+			s->setParent(0);
+			s->deleteLater();
+		}
+
+		attempts.clear();
+	}
+
+	static ErrorCondition connectError(QAbstractSocket::SocketError socketError)
+	{
+		if(socketError == QAbstractSocket::ConnectionRefusedError)
+			return ErrorConnect;
+		else
+			return ErrorGeneric;
+	}
+
+	void noteError(ErrorCondition e)
+	{
+		if(errorPriority(e) > errorPriority(mostSignificantError))
+			mostSignificantError = e;
+	}
+
 	void start(const QUrl &uri, const HttpHeaders &headers)
 	{
 		requestUri = uri;
@@ -429,6 +472,7 @@ public:
 		inbuf.clear();
 		inStatusLine = true;
 		pendingRead = false;
+		addrs.clear();
 
 		if(!connectHost.isEmpty())
 			host = connectHost;
@@ -863,12 +907,18 @@ public:
 	}
 
 private slots:
+	// starts a connection attempt to the next address, racing any that
+	//   are still pending. the first to connect wins
 	void tryNextAddress()
 	{
 		QPointer<QObject> self = this;
 
 		if(addrs.isEmpty())
 		{
+			// wait for the pending attempts, if any
+			if(!attempts.isEmpty())
+				return;
+
 			state = Idle;
 			errorCondition = mostSignificantError;
 			emit q->error();
@@ -883,33 +933,105 @@ private slots:
 		if(!self)
 			return;
 
-		sock = new QSslSocket(this);
-		connect(sock, &QSslSocket::connected, this, &Private::sock_connected);
-		connect(sock, &QSslSocket::readyRead, this, &Private::sock_readyRead);
-		connect(sock, &QSslSocket::bytesWritten, this, &Private::sock_bytesWritten);
-		connect(sock, &QSslSocket::disconnected, this, &Private::sock_disconnected);
+		QSslSocket *s = new QSslSocket(this);
+		connect(s, &QSslSocket::connected, this, &Private::attempt_connected);
 #if QT_VERSION >= 0x060000
-		connect(sock, &QSslSocket::errorOccurred, this, &Private::sock_error);
-		connect(sock, &QSslSocket::sslErrors, this, &Private::sock_sslErrors);
+		connect(s, &QSslSocket::errorOccurred, this, &Private::attempt_error);
 #else
-		connect(sock, static_cast<void (QSslSocket::*)(QAbstractSocket::SocketError)>(&QSslSocket::error), this, &Private::sock_error);
-		connect(sock, static_cast<void (QSslSocket::*)(const QList<QSslError> &)>(&QSslSocket::sslErrors), this, &Private::sock_sslErrors);
+		connect(s, static_cast<void (QSslSocket::*)(QAbstractSocket::SocketError)>(&QSslSocket::error), this, &Private::attempt_error);
 #endif
+		attempts += s;
 
 		bool useSsl = (requestUri.scheme() == "wss");
 		int port = requestUri.port(useSsl ? 443 : 80);
 
 		log_debug("ws: connecting to %s:%d%s", qPrintable(addr.toString()), port, useSsl ? " (ssl)" : "");
 
+		// connect to the address that passed the policy check, rather
+		//   than resolving the name again
 		if(useSsl)
-			sock->connectToHostEncrypted(addr.toString(), port, requestUri.host());
+			s->connectToHostEncrypted(addr.toString(), port, requestUri.host());
 		else
-			sock->connectToHost(host, port);
+			s->connectToHost(addr, port);
+
+		if(!addrs.isEmpty())
+			attemptTimer->start(CONNECT_ATTEMPT_DELAY);
 	}
 
 	void resolver_resultsReady(const QList<QHostAddress> &results)
 	{
-		addrs += results;
+		// alternate address families, starting with the resolver's
+		//   preferred one, so a broken family doesn't hold up the other
+		QList<QHostAddress> first, second;
+		QAbstractSocket::NetworkLayerProtocol firstProtocol = QAbstractSocket::UnknownNetworkLayerProtocol;
+		foreach(const QHostAddress &addr, results)
+		{
+			if(!allowIPv6 && addr.protocol() != QAbstractSocket::IPv4Protocol)
+			{
+				log_debug("ws: skipping %s", qPrintable(addr.toString()));
+				noteError(ErrorPolicy);
+				continue;
+			}
+
+			if(firstProtocol == QAbstractSocket::UnknownNetworkLayerProtocol)
+				firstProtocol = addr.protocol();
+
+			if(addr.protocol() == firstProtocol)
+				first += addr;
+			else
+				second += addr;
+		}
+
+		while(!first.isEmpty() || !second.isEmpty())
+		{
+			if(!first.isEmpty())
+				addrs += first.takeFirst();
+			if(!second.isEmpty())
+				addrs += second.takeFirst();
+		}
+
+		tryNextAddress();
+	}
+
+	void attempt_connected()
+	{
+		QSslSocket *s = (QSslSocket *)sender();
+
+		attempts.removeAll(s);
+		cancelAttempts();
+
+		s->disconnect(this);
+
+		sock = s;
+		connect(sock, &QSslSocket::readyRead, this, &Private::sock_readyRead);
+		connect(sock, &QSslSocket::bytesWritten, this, &Private::sock_bytesWritten);
+		connect(sock, &QSslSocket::disconnected, this, &Private::sock_disconnected);
+#if QT_VERSION >= 0x060000
+		connect(sock, &QSslSocket::errorOccurred, this, &Private::sock_error);
+		connect(sock, &QSslSocket::sslErrors, this, &Private::sock_sslErrors);
+#else
+		connect(sock, static_cast<void (QSslSocket::*)(QAbstractSocket::SocketError)>(&QSslSocket::error), this, &Private::sock_error);
+		connect(sock, static_cast<void (QSslSocket::*)(const QList<QSslError> &)>(&QSslSocket::sslErrors), this, &Private::sock_sslErrors);
+#endif
+
+		sock_connected();
+	}
+
+	void attempt_error(QAbstractSocket::SocketError socketError)
+	{
+		QSslSocket *s = (QSslSocket *)sender();
+
+		log_debug("ws: attempt error: %d", (int)socketError);
+
+		noteError(connectError(socketError));
+
+		attempts.removeAll(s);
+		s->disconnect(this);
+		s->setParent(0);
+		s->deleteLater();
+
+		// don't wait out the delay when an attempt fails
+		attemptTimer->stop();
 		tryNextAddress();
 	}
 
@@ -1121,8 +1243,7 @@ private slots:
 			return;
 		}
 
-		if(errorPriority(curError) > errorPriority(mostSignificantError))
-			mostSignificantError = curError;
+		noteError(curError);
 
 		cleanup();
 		tryNextAddress();
@@ -1191,6 +1312,11 @@ void WebSocket::setIgnoreTlsErrors(bool on)
 	d->ignoreTlsErrors = on;
 }
 
+void WebSocket::setAllowIPv6(bool on)
+{
+	d->allowIPv6 = on;
+}
+
 void WebSocket::setFollowRedirects(int maxRedirects)
 {
 	d->maxRedirects = maxRedirects;
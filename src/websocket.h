@@ -90,6 +90,7 @@ public:
 	void setConnectHost(const QString &host);
 	void setTrustConnectHost(bool on);
 	void setIgnoreTlsErrors(bool on);
+	void setAllowIPv6(bool on);
 	void setFollowRedirects(int maxRedirects); // -1 to disable
 	void setMaxFrameSize(int size);
 
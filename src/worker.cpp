@@ -30,17 +30,24 @@
 
 #include <assert.h>
 #include <QVariant>
-#include <QTimer>
 #include <QPointer>
+#include <QHostAddress>
 #include "httprequest.h"
 #include "websocket.h"
 #include "zhttprequestpacket.h"
 #include "zhttpresponsepacket.h"
 #include "bufferlist.h"
-#include "log.h"
+#include "logutil.h"
+#include "accesslog.h"
 #include "appconfig.h"
+#include "timerwheel.h"
+#include "packetcoalescer.h"
+#include "hostlimiter.h"
+#include "stats.h"
+#include "zhttpcodec.h"
 
 #define SESSION_EXPIRE 60000
+#define PREWARM_COUNT_MAX 100
 
 class Worker::Private : public QObject
 {
@@ -82,6 +89,7 @@ public:
 	bool ignorePolicies;
 	int sessionTimeout;
 	HttpRequest *hreq;
+	QList<HttpRequest*> warmReqs; // other connections opened by a prewarm
 	WebSocket *ws;
 	bool quiet;
 	bool sentHeader;
@@ -89,11 +97,16 @@ public:
 	bool stuffToRead;
 	BufferList inbuf; // for single mode
 	int bytesReceived;
-	QTimer *expireTimer;
-	QTimer *httpActivityTimer;
-	QTimer *httpSessionTimer;
-	QTimer *keepAliveTimer;
-	QTimer *updateTimer;
+	WheelTimer expireTimer;
+	WheelTimer httpActivityTimer;
+	WheelTimer httpSessionTimer;
+	WheelTimer keepAliveTimer;
+	WheelTimer flushTimer;
+	int flushSize;
+	int flushDelay;
+	bool flushDue;
+	bool updatePending;
+	bool updateQueued;
 	WebSocket::Frame::Type lastReceivedFrameType;
 	bool wsSendingMessage;
 	QList<int> wsPendingWrites;
@@ -101,6 +114,17 @@ public:
 	bool wsPendingPeerClose;
 	bool multi;
 	bool quietLog;
+	PacketCoalescer *coalescer;
+	HostLimiter *hostLimiter;
+	QByteArray hostKey; // set while holding or waiting for a host slot
+	bool hostQueued;
+	QString pendingMethod;
+	QUrl pendingUri;
+	HttpHeaders pendingHeaders;
+	bool pendingHasBody;
+	BufferList pendingBody; // request body received while queued
+	ZhttpCodec::RequestExtras extras;
+	int gauge;
 
 	Private(AppConfig *_config, Worker::Format _format, Worker *_q) :
 		QObject(_q),
@@ -110,72 +134,66 @@ public:
 		state(NotStarted),
 		hreq(0),
 		ws(0),
-		expireTimer(0),
-		httpActivityTimer(0),
-		httpSessionTimer(0),
-		keepAliveTimer(0),
+		updatePending(false),
+		updateQueued(false),
 		lastReceivedFrameType(WebSocket::Frame::Text),
 		wsSendingMessage(false),
 		wsClosed(false),
 		wsPendingPeerClose(false),
 		multi(false),
-		quietLog(false)
+		quietLog(false),
+		coalescer(0),
+		hostLimiter(0),
+		hostQueued(false),
+		gauge(-1)
 	{
-		updateTimer = new QTimer(this);
-		connect(updateTimer, &QTimer::timeout, this, &Private::doUpdate);
-		updateTimer->setSingleShot(true);
+		// timers are kept on the thread's timer wheel rather than as
+		//   QTimers, since there may be many thousands of idle sessions
+		expireTimer.setCallback([=]() { expire_timeout(); });
+		httpActivityTimer.setCallback([=]() { httpActivity_timeout(); });
+		httpSessionTimer.setCallback([=]() { httpSession_timeout(); });
+		keepAliveTimer.setCallback([=]() { keepAlive_timeout(); });
+		flushTimer.setCallback([=]() { flush_timeout(); });
 	}
 
 	~Private()
 	{
 		cleanup();
 
-		updateTimer->disconnect(this);
-		updateTimer->setParent(0);
-		updateTimer->deleteLater();
+		if(gauge != -1)
+			Stats::add((Stats::Counter)gauge, -1);
 	}
 
 	void cleanup()
 	{
-		updateTimer->stop();
+		updatePending = false;
 
 		delete hreq;
 		hreq = 0;
 
+		qDeleteAll(warmReqs);
+		warmReqs.clear();
+
 		delete ws;
 		ws = 0;
 
-		if(expireTimer)
-		{
-			expireTimer->disconnect(this);
-			expireTimer->setParent(0);
-			expireTimer->deleteLater();
-			expireTimer = 0;
-		}
+		expireTimer.stop();
+		httpActivityTimer.stop();
+		httpSessionTimer.stop();
+		keepAliveTimer.stop();
+		flushTimer.stop();
 
-		if(httpActivityTimer)
-		{
-			httpActivityTimer->disconnect(this);
-			httpActivityTimer->setParent(0);
-			httpActivityTimer->deleteLater();
-			httpActivityTimer = 0;
-		}
+		if(coalescer && !rid.isEmpty())
+			coalescer->remove(rid);
 
-		if(httpSessionTimer)
+		if(!hostKey.isEmpty())
 		{
-			httpSessionTimer->disconnect(this);
-			httpSessionTimer->setParent(0);
-			httpSessionTimer->deleteLater();
-			httpSessionTimer = 0;
+			hostLimiter->release(hostKey, this);
+			hostKey.clear();
 		}
 
-		if(keepAliveTimer)
-		{
-			keepAliveTimer->disconnect(this);
-			keepAliveTimer->setParent(0);
-			keepAliveTimer->deleteLater();
-			keepAliveTimer = 0;
-		}
+		hostQueued = false;
+		pendingBody.clear();
 
 		state = Stopped;
 	}
@@ -202,6 +220,8 @@ public:
 		multi = request.multi;
 		quietLog = request.quiet;
 
+		Stats::add(Stats::RequestsStarted);
+
 		if(request.uri.isEmpty())
 		{
 			log_warning("missing request uri");
@@ -237,6 +257,14 @@ public:
 			return;
 		}
 
+		if(transport == WebSocketTransport)
+			gauge = Stats::WorkersWebSocket;
+		else if(mode == Worker::Stream)
+			gauge = Stats::WorkersHttpStream;
+		else
+			gauge = Stats::WorkersHttpSingle;
+		Stats::add((Stats::Counter)gauge);
+
 		int defaultPort;
 		if(scheme == "https" || scheme == "wss")
 			defaultPort = 443;
@@ -259,6 +287,10 @@ public:
 			else
 				outStream = false;
 
+			flushSize = (extras.flushSize != -1 ? extras.flushSize : config->flushSize);
+			flushDelay = (extras.flushDelay != -1 ? extras.flushDelay : config->flushDelay);
+			flushDue = false;
+
 			if(request.method.isEmpty())
 			{
 				log_warning("missing request method");
@@ -267,7 +299,7 @@ public:
 				return;
 			}
 
-			log(infoLevel, "IN id=%s, %s %s", rid.data(), qPrintable(request.method), uri.toEncoded().data());
+			accesslog_write(infoLevel, "IN id=%s, %s %s", rid.data(), qPrintable(request.method), uri.toEncoded().data());
 
 			// inbound streaming must start with sequence number of 0
 			if(mode == Worker::Stream && request.more && seq != 0)
@@ -309,6 +341,50 @@ public:
 				headers += HttpHeader("Host", hostHeader);
 			}
 
+			if(hostLimiter)
+			{
+				// limit by where we actually connect
+				QByteArray key;
+				if(!request.connectHost.isEmpty())
+					key = request.connectHost.toUtf8();
+				else
+					key = uri.host().toUtf8();
+				key += ':' + QByteArray::number(request.connectPort != -1 ? request.connectPort : port);
+
+				HostLimiter::Result r = hostLimiter->acquire(key, this, [=]() { host_acquired(); });
+				if(r == HostLimiter::Rejected)
+				{
+					log_warning("too many requests queued for %s", key.data());
+
+					// not "rejected", which means the origin refused a
+					//   websocket handshake
+					deferError("undefined-condition");
+					return;
+				}
+
+				hostKey = key;
+				hostQueued = (r == HostLimiter::Queued);
+			}
+
+			QByteArray httpVersionStr = extras.httpVersion;
+			if(httpVersionStr.isEmpty() && config->http2)
+				httpVersionStr = "2";
+
+			HttpRequest::HttpVersion httpVersion = HttpRequest::DefaultHttpVersion;
+			if(httpVersionStr == "1.1")
+				httpVersion = HttpRequest::Http1_1;
+			else if(httpVersionStr == "2")
+				httpVersion = HttpRequest::Http2;
+			else if(httpVersionStr == "2-prior-knowledge")
+				httpVersion = HttpRequest::Http2PriorKnowledge;
+			else if(!httpVersionStr.isEmpty())
+			{
+				log_warning("unsupported http-version: %s", httpVersionStr.data());
+
+				deferError("bad-request");
+				return;
+			}
+
 			hreq = new HttpRequest(this);
 			connect(hreq, &HttpRequest::nextAddress, this, &Private::req_nextAddress);
 			connect(hreq, &HttpRequest::readyRead, this, &Private::req_readyRead);
@@ -318,13 +394,43 @@ public:
 			maxResponseSize = request.maxSize;
 			sessionTimeout = request.timeout;
 
-			hreq->setAllowIPv6(config->allowIPv6);
+			setupRequest(hreq, request, httpVersion);
 
-			if(!request.connectHost.isEmpty())
-				hreq->setConnectHostPort(request.connectHost, request.connectPort);
+			hreq->setDecodeContent(extras.decodeContent);
+
+			if(extras.prewarm)
+			{
+				if(!request.body.isEmpty() || request.more)
+				{
+					log_warning("prewarm request cannot have a body");
+
+					deferError("bad-request");
+					return;
+				}
+
+				int count = (extras.prewarmCount != -1 ? extras.prewarmCount : 1);
+				if(count < 1 || count > PREWARM_COUNT_MAX)
+				{
+					log_warning("prewarm-count must be between 1 and %d", PREWARM_COUNT_MAX);
+
+					deferError("bad-request");
+					return;
+				}
+
+				// the session's own request opens one of the connections
+				for(int n = 1; n < count; ++n)
+				{
+					HttpRequest *req = new HttpRequest(this);
+					connect(req, &HttpRequest::nextAddress, this, &Private::warmReq_nextAddress);
+					connect(req, &HttpRequest::readyRead, this, &Private::warmReq_readyRead);
+					connect(req, &HttpRequest::error, this, &Private::warmReq_error);
+
+					setupRequest(req, request, httpVersion);
+
+					warmReqs += req;
+				}
+			}
 
-			hreq->setTrustConnectHost(request.trustConnectHost);
-			hreq->setIgnoreTlsErrors(request.ignoreTlsErrors);
 			if(request.followRedirects)
 				hreq->setFollowRedirects(8);
 
@@ -333,7 +439,7 @@ public:
 		}
 		else // WebSocketTransport
 		{
-			log(infoLevel, "IN id=%s, %s", rid.data(), uri.toEncoded().data());
+			accesslog_write(infoLevel, "IN id=%s, %s", rid.data(), uri.toEncoded().data());
 
 			// inbound streaming must start with sequence number of 0
 			if(seq != 0)
@@ -388,6 +494,7 @@ public:
 
 			ws->setTrustConnectHost(request.trustConnectHost);
 			ws->setIgnoreTlsErrors(request.ignoreTlsErrors);
+			ws->setAllowIPv6(config->allowIPv6);
 			if(request.followRedirects)
 				ws->setFollowRedirects(8);
 			ws->setMaxFrameSize(config->sessionBufferSize);
@@ -396,29 +503,15 @@ public:
 				outCredits += request.credits;
 		}
 
-		httpActivityTimer = new QTimer(this);
-		connect(httpActivityTimer, &QTimer::timeout, this, &Private::httpActivity_timeout);
-		httpActivityTimer->setSingleShot(true);
-		httpActivityTimer->start(config->activityTimeout * 1000);
+		httpActivityTimer.start(config->activityTimeout * 1000);
 
 		if(sessionTimeout != -1)
-		{
-			httpSessionTimer = new QTimer(this);
-			connect(httpSessionTimer, &QTimer::timeout, this, &Private::httpSession_timeout);
-			httpSessionTimer->setSingleShot(true);
-			httpSessionTimer->start(sessionTimeout);
-		}
+			httpSessionTimer.start(sessionTimeout);
 
 		if(transport == WebSocketTransport || (transport == HttpTransport && mode == Worker::Stream))
 		{
-			expireTimer = new QTimer(this);
-			connect(expireTimer, &QTimer::timeout, this, &Private::expire_timeout);
-			expireTimer->setSingleShot(true);
-			expireTimer->start(SESSION_EXPIRE);
-
-			keepAliveTimer = new QTimer(this);
-			connect(keepAliveTimer, &QTimer::timeout, this, &Private::keepAlive_timeout);
-			keepAliveTimer->start(SESSION_EXPIRE / 2);
+			expireTimer.start(SESSION_EXPIRE);
+			keepAliveTimer.start(SESSION_EXPIRE / 2);
 		}
 
 		if(transport == HttpTransport)
@@ -428,18 +521,34 @@ public:
 
 			bool hasOrMightHaveBody = (!request.body.isEmpty() || request.more);
 
-			hreq->start(request.method, uri, headers, hasOrMightHaveBody);
+			// a prewarm only needs the connection, kept alive for reuse
+			QString method = (extras.prewarm ? QString("HEAD") : request.method);
+
+			if(hostQueued)
+			{
+				// hold on to the request until the host has a free slot.
+				//   the client can still send body up to its credits
+				pendingMethod = method;
+				pendingUri = uri;
+				pendingHeaders = headers;
+				pendingHasBody = hasOrMightHaveBody;
+			}
+			else
+			{
+				hreq->start(method, uri, headers, hasOrMightHaveBody);
+				startWarmRequests(uri, headers);
+			}
 
 			if(hasOrMightHaveBody)
 			{
 				if(!request.body.isEmpty())
-					hreq->writeBody(request.body);
-
-				if(!request.more)
 				{
-					bodySent = true;
-					hreq->endBody();
+					Stats::add(Stats::BytesIn, request.body.size());
+					writeBody(request.body);
 				}
+
+				if(!request.more)
+					endBody();
 			}
 			else
 				bodySent = true;
@@ -515,14 +624,14 @@ public:
 				refreshActivityTimeout();
 
 				if(!request.body.isEmpty())
-					hreq->writeBody(request.body);
+				{
+					Stats::add(Stats::BytesIn, request.body.size());
+					writeBody(request.body);
+				}
 
 				// the 'more' flag only has significance if body field present
 				if(!request.more)
-				{
-					bodySent = true;
-					hreq->endBody();
-				}
+					endBody();
 			}
 		}
 		else // WebSocketTransport
@@ -552,6 +661,7 @@ public:
 						wsSendingMessage = request.more;
 
 						wsPendingWrites += request.body.size();
+						Stats::add(Stats::BytesIn, request.body.size());
 						ws->writeFrame(WebSocket::Frame(ftype, request.body, request.more));
 					}
 					else if(request.type == ZhttpRequestPacket::Ping)
@@ -584,70 +694,62 @@ public:
 			update();
 	}
 
-	static bool matchExp(const QString &exp, const QString &s)
+	bool isAllowed(const QString &in) const
 	{
-		QHostAddress addr(s);
-
-		if(!addr.isNull())
-		{
-			int at = exp.indexOf('/');
-			if(at != -1)
-			{
-				QPair<QHostAddress, int> sn = QHostAddress::parseSubnet(exp);
-				if(!sn.first.isNull())
-				{
-					return addr.isInSubnet(sn.first, sn.second);
-				}
-			}
-		}
-
-		int at = exp.indexOf('*');
-		if(at != -1)
-		{
-			QString start = exp.mid(0, at);
-			QString end = exp.mid(at + 1);
-			return (s.startsWith(start, Qt::CaseInsensitive) && s.endsWith(end, Qt::CaseInsensitive));
-		}
+		if(ignorePolicies)
+			return true;
 
-		return (s.compare(exp, Qt::CaseInsensitive) == 0);
+		return config->accessPolicy.isAllowed(in);
 	}
 
-	bool checkAllow(const QString &in) const
+	bool isAllowed(const QHostAddress &addr) const
 	{
-		foreach(const QString &exp, config->allowExps)
-		{
-			if(matchExp(exp, in))
-				return true;
-		}
+		if(ignorePolicies)
+			return true;
 
-		return false;
+		return config->accessPolicy.isAllowed(addr);
 	}
 
-	bool checkDeny(const QString &in) const
+	// keep-alives and credits can be batched with those of other sessions,
+	//   if the receiver supports multi-id packets. the first packet of a
+	//   session is never delayed, since the receiver needs it to learn
+	//   our address
+	bool canCoalesce(const ZhttpResponsePacket &resp) const
 	{
-		foreach(const QString &exp, config->denyExps)
-		{
-			if(matchExp(exp, in))
-				return true;
-		}
+		if(!coalescer || toAddress.isEmpty() || rid.isEmpty() || !multi || userData.isValid() || quiet || outSeq == 0)
+			return false;
 
-		return false;
-	}
+		if(resp.type == ZhttpResponsePacket::KeepAlive)
+			return true;
 
-	bool isAllowed(const QString &in) const
-	{
-		if(ignorePolicies)
+		if(resp.type == ZhttpResponsePacket::Credit && resp.credits > 0)
 			return true;
 
-		if(config->defaultPolicy == "allow")
-			return !checkDeny(in) || checkAllow(in);
-		else
-			return checkAllow(in) && !checkDeny(in);
+		return false;
 	}
 
 	// emits signals, but safe to delete after
 	void writeResponse(const ZhttpResponsePacket &resp)
 	{
+		if(coalescer && !rid.isEmpty())
+		{
+			if(canCoalesce(resp))
+			{
+				coalescer->add(format, toAddress, rid, (resp.type == ZhttpResponsePacket::Credit ? resp.credits : 0), [=]() { return outSeq++; });
+				return;
+			}
+
+			// anything already queued must go out first, to keep the
+			//   sequence in order
+			if(coalescer->hasPending(rid))
+			{
+				QPointer<QObject> self = this;
+				coalescer->flush(rid);
+				if(!self)
+					return;
+			}
+		}
+
 		ZhttpResponsePacket out = resp;
 
 		if(!toAddress.isEmpty())
@@ -670,12 +772,21 @@ public:
 
 		if(out.type == ZhttpResponsePacket::Error)
 		{
-			log(infoLevel, "OUT ERR id=%s condition=%s", outRid.data(), out.condition.data());
+			accesslog_write(infoLevel, "OUT ERR id=%s condition=%s", outRid.data(), out.condition.data());
 		}
 		else if(out.type == ZhttpResponsePacket::Data)
 		{
+			Stats::add(Stats::BytesOut, out.body.size());
+
 			if(resp.code != -1)
-				log(infoLevel, "OUT id=%s code=%d %d%s", outRid.data(), out.code, out.body.size(), out.more ? " M" : "");
+			{
+				// note how the request was carried, if http/2 was involved
+				QByteArray via;
+				if(hreq && hreq->negotiatedHttpVersion() == HttpRequest::Http2)
+					via = hreq->connectionReused() ? " h2 stream" : " h2 new-conn";
+
+				accesslog_write(infoLevel, "OUT id=%s code=%d %d%s%s", outRid.data(), out.code, out.body.size(), out.more ? " M" : "", via.data());
+			}
 			else
 				log_debug("OUT id=%s %d%s", outRid.data(), out.body.size(), out.more ? " M" : "");
 		}
@@ -686,8 +797,42 @@ public:
 
 	void update()
 	{
-		if(!updateTimer->isActive())
-			updateTimer->start();
+		updatePending = true;
+
+		if(!updateQueued)
+		{
+			updateQueued = true;
+			QMetaObject::invokeMethod(this, "queuedUpdate", Qt::QueuedConnection);
+		}
+	}
+
+	// like nagle's algorithm: while less than flushSize is buffered, wait
+	//   for more, but no longer than flushDelay after the first byte
+	bool holdForFlush()
+	{
+		if(flushSize <= 0 || flushDelay <= 0 || flushDue)
+			return false;
+
+		// more than the buffer can currently hold might never arrive, and
+		//   would always wait out the delay
+		int threshold = qMin(flushSize, hreq->responseBufferCapacity());
+		if(hreq->isFinished() || hreq->bytesAvailable() >= threshold)
+			return false;
+
+		// waiting won't produce a larger packet if credits are short
+		if(!quiet && outCredits < threshold)
+			return false;
+
+		if(!flushTimer.isActive())
+			flushTimer.start(flushDelay);
+
+		return true;
+	}
+
+	void flush_timeout()
+	{
+		flushDue = true;
+		update();
 	}
 
 	void deferFinished()
@@ -704,6 +849,71 @@ public:
 		update();
 	}
 
+	void writeBody(const QByteArray &body)
+	{
+		if(hostQueued)
+			pendingBody += body;
+		else
+			hreq->writeBody(body);
+	}
+
+	void endBody()
+	{
+		bodySent = true;
+
+		if(!hostQueued)
+			hreq->endBody();
+	}
+
+	void host_acquired()
+	{
+		if(!hostQueued)
+			return;
+
+		hostQueued = false;
+
+		hreq->start(pendingMethod, pendingUri, pendingHeaders, pendingHasBody);
+		startWarmRequests(pendingUri, pendingHeaders);
+
+		pendingHeaders.clear();
+
+		if(!pendingBody.isEmpty())
+			hreq->writeBody(pendingBody.take());
+
+		if(pendingHasBody && bodySent)
+			hreq->endBody();
+	}
+
+	void setupRequest(HttpRequest *req, const ZhttpRequestPacket &request, HttpRequest::HttpVersion httpVersion)
+	{
+		req->setAllowIPv6(config->allowIPv6);
+
+		if(!request.connectHost.isEmpty())
+			req->setConnectHostPort(request.connectHost, request.connectPort);
+
+		req->setTrustConnectHost(request.trustConnectHost);
+		req->setIgnoreTlsErrors(request.ignoreTlsErrors);
+		req->setHttpVersion(httpVersion);
+	}
+
+	void startWarmRequests(const QUrl &uri, const HttpHeaders &headers)
+	{
+		foreach(HttpRequest *req, warmReqs)
+			req->start("HEAD", uri, headers, false);
+	}
+
+	void finishWarmRequest(HttpRequest *req)
+	{
+		warmReqs.removeAll(req);
+		req->disconnect(this);
+		req->setParent(0);
+		req->deleteLater();
+
+		// the prewarm response waits for all of the connections
+		if(warmReqs.isEmpty())
+			update();
+	}
+
 	void deferError(const QByteArray &condition)
 	{
 		cleanup();
@@ -714,12 +924,12 @@ public:
 
 	void refreshTimeout()
 	{
-		expireTimer->start(SESSION_EXPIRE);
+		expireTimer.start(SESSION_EXPIRE);
 	}
 
 	void refreshActivityTimeout()
 	{
-		httpActivityTimer->start(config->activityTimeout * 1000);
+		httpActivityTimer.start(config->activityTimeout * 1000);
 	}
 
 	void respondError(const QByteArray &condition)
@@ -731,6 +941,8 @@ public:
 	{
 		QPointer<QObject> self = this;
 
+		Stats::addError(condition);
+
 		ZhttpResponsePacket resp;
 		resp.type = ZhttpResponsePacket::Error;
 		resp.condition = condition;
@@ -767,20 +979,30 @@ public:
 	}
 
 private slots:
+	void queuedUpdate()
+	{
+		updateQueued = false;
+
+		if(updatePending)
+			doUpdate();
+	}
+
 	// emits signals, but safe to delete after
 	void doUpdate()
 	{
 		QPointer<QObject> self = this;
 
 		// if we had a pending update, we can cancel since we're updating now
-		if(updateTimer->isActive())
-			updateTimer->stop();
+		updatePending = false;
 
 		if(transport == HttpTransport)
 		{
 			if(state == Started)
 			{
-				if(!stuffToRead)
+				if(!stuffToRead || !warmReqs.isEmpty())
+					return;
+
+				if(outStream && sentHeader && holdForFlush())
 					return;
 
 				stuffToRead = false;
@@ -788,7 +1010,15 @@ private slots:
 				ZhttpResponsePacket resp;
 				resp.type = ZhttpResponsePacket::Data;
 
-				if(!sentHeader)
+				if(!sentHeader && extras.prewarm)
+				{
+					// connections are open, and there is nothing else to
+					//   report
+					resp.code = 204;
+					resp.reason = "No Content";
+					sentHeader = true;
+				}
+				else if(!sentHeader)
 				{
 					resp.code = hreq->responseCode();
 					resp.reason = hreq->responseReason();
@@ -809,6 +1039,12 @@ private slots:
 					else
 						buf = hreq->readResponseBody(); // all
 
+					// a read cut short by credits or by the buffer's chunk
+					//   size leaves bytes that are already due. only wait
+					//   again once everything buffered has been sent
+					flushTimer.stop();
+					flushDue = (hreq->bytesAvailable() > 0);
+
 					if(!buf.isEmpty())
 					{
 						if(maxResponseSize != -1 && bytesReceived + buf.size() > maxResponseSize)
@@ -828,7 +1064,14 @@ private slots:
 					resp.more = (hreq->bytesAvailable() > 0 || !hreq->isFinished());
 
 					if(hreq->bytesAvailable() > 0)
+					{
 						stuffToRead = true;
+
+						// reads may return a single buffer chunk at a
+						//   time, so keep going while credits remain
+						if(quiet || outCredits > 0)
+							update();
+					}
 				}
 				else
 				{
@@ -953,7 +1196,7 @@ private slots:
 
 	void req_nextAddress(const QHostAddress &addr)
 	{
-		if(!isAllowed(addr.toString()))
+		if(!isAllowed(addr))
 			hreq->blockAddress();
 	}
 
@@ -993,6 +1236,30 @@ private slots:
 		update();
 	}
 
+	void warmReq_nextAddress(const QHostAddress &addr)
+	{
+		if(!isAllowed(addr))
+			((HttpRequest *)sender())->blockAddress();
+	}
+
+	void warmReq_readyRead()
+	{
+		HttpRequest *req = (HttpRequest *)sender();
+		req->readResponseBody();
+		if(req->isFinished())
+			finishWarmRequest(req);
+	}
+
+	// the session's own request decides the outcome
+	void warmReq_error()
+	{
+		HttpRequest *req = (HttpRequest *)sender();
+
+		log_debug("prewarm connection failed: %s", rid.data());
+
+		finishWarmRequest(req);
+	}
+
 	void req_bytesWritten(int count)
 	{
 		if(!bodySent)
@@ -1032,7 +1299,7 @@ private slots:
 
 	void ws_nextAddress(const QHostAddress &addr)
 	{
-		if(!isAllowed(addr.toString()))
+		if(!isAllowed(addr))
 			respondError("policy-violation");
 	}
 
@@ -1148,6 +1415,8 @@ private slots:
 
 	void keepAlive_timeout()
 	{
+		keepAliveTimer.start(SESSION_EXPIRE / 2);
+
 		ZhttpResponsePacket resp;
 		resp.type = ZhttpResponsePacket::KeepAlive;
 		writeResponse(resp);
@@ -1170,6 +1439,21 @@ QByteArray Worker::rid() const
 	return d->rid;
 }
 
+void Worker::setCoalescer(PacketCoalescer *coalescer)
+{
+	d->coalescer = coalescer;
+}
+
+void Worker::setHostLimiter(HostLimiter *hostLimiter)
+{
+	d->hostLimiter = hostLimiter;
+}
+
+void Worker::setRequestExtras(const ZhttpCodec::RequestExtras &extras)
+{
+	d->extras = extras;
+}
+
 Worker::Format Worker::format() const
 {
 	return d->format;
@@ -35,6 +35,12 @@ class QVariant;
 class ZhttpRequestPacket;
 class ZhttpResponsePacket;
 class AppConfig;
+class PacketCoalescer;
+class HostLimiter;
+
+namespace ZhttpCodec {
+class RequestExtras;
+}
 
 class Worker : public QObject
 {
@@ -46,12 +52,14 @@ public:
 		Single, // for REQ/REP
 		Stream  // for PUSH/PUB
 	};
+	Q_ENUM(Mode)
 
 	enum Format
 	{
 		TnetStringFormat,
 		JsonFormat
 	};
+	Q_ENUM(Format)
 
 	Worker(AppConfig *config, Format format, QObject *parent = 0);
 	~Worker();
@@ -59,6 +67,11 @@ public:
 	QByteArray rid() const;
 	Format format() const;
 
+	// must be set before start()
+	void setCoalescer(PacketCoalescer *coalescer);
+	void setHostLimiter(HostLimiter *hostLimiter);
+	void setRequestExtras(const ZhttpCodec::RequestExtras &extras);
+
 	void start(const QByteArray &id, int seq, const ZhttpRequestPacket &request, Mode mode);
 	void write(int seq, const ZhttpRequestPacket &request);
 
@@ -0,0 +1,1967 @@
+/*
+ * Copyright (C) 2026 Fanout, Inc.
+ *
+ * This file is part of Zurl.
+ *
+ * $FANOUT_BEGIN_LICENSE:GPL$
+ *
+ * Zurl is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zurl is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Zurl may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#include "zhttpcodec.h"
+
+#include <string.h>
+#include <QVarLengthArray>
+#include <QUrl>
+#include <QJsonDocument>
+#include <QJsonArray>
+#include "tnetstring.h"
+#include "zhttprequestpacket.h"
+#include "zhttpresponsepacket.h"
+
+namespace ZhttpCodec {
+
+// containers nested deeper than this are not decoded directly. values are
+//   walked recursively, so this also bounds stack use
+static const int MAX_NESTING_DEPTH = 64;
+
+enum ValueType
+{
+	InvalidValue,
+	BytesValue,
+	IntValue,
+	DoubleValue,
+	BoolValue,
+	NullValue,
+	ListValue,
+	MapValue
+};
+
+// return true if item modified
+static bool convertToJsonStyleInPlace(QVariant *in)
+{
+	// Hash -> Map
+	// ByteArray (UTF-8) -> String
+
+	bool changed = false;
+
+	int type = in->type();
+	if(type == QVariant::Hash)
+	{
+		QVariantMap vmap;
+		QVariantHash vhash = in->toHash();
+		QHashIterator<QString, QVariant> it(vhash);
+		while(it.hasNext())
+		{
+			it.next();
+			QVariant i = it.value();
+			convertToJsonStyleInPlace(&i);
+			vmap[it.key()] = i;
+		}
+
+		*in = vmap;
+		changed = true;
+	}
+	else if(type == QVariant::List)
+	{
+		QVariantList vlist = in->toList();
+		for(int n = 0; n < vlist.count(); ++n)
+		{
+			QVariant i = vlist.at(n);
+			convertToJsonStyleInPlace(&i);
+			vlist[n] = i;
+		}
+
+		*in = vlist;
+		changed = true;
+	}
+	else if(type == QVariant::ByteArray)
+	{
+		*in = QVariant(QString::fromUtf8(in->toByteArray()));
+		changed = true;
+	}
+
+	return changed;
+}
+
+QVariant convertToJsonStyle(const QVariant &in)
+{
+	QVariant v = in;
+	convertToJsonStyleInPlace(&v);
+	return v;
+}
+
+// return true if item modified
+static bool convertFromJsonStyleInPlace(QVariant *in)
+{
+	// Map -> Hash
+	// String -> ByteArray (UTF-8)
+
+	bool changed = false;
+
+	int type = in->type();
+	if(type == QVariant::Map)
+	{
+		QVariantHash vhash;
+		QVariantMap vmap = in->toMap();
+		QMapIterator<QString, QVariant> it(vmap);
+		while(it.hasNext())
+		{
+			it.next();
+			QVariant i = it.value();
+			convertFromJsonStyleInPlace(&i);
+			vhash[it.key()] = i;
+		}
+
+		*in = vhash;
+		changed = true;
+	}
+	else if(type == QVariant::List)
+	{
+		QVariantList vlist = in->toList();
+		for(int n = 0; n < vlist.count(); ++n)
+		{
+			QVariant i = vlist.at(n);
+			convertFromJsonStyleInPlace(&i);
+			vlist[n] = i;
+		}
+
+		*in = vlist;
+		changed = true;
+	}
+	else if(type == QVariant::String)
+	{
+		*in = QVariant(in->toString().toUtf8());
+		changed = true;
+	}
+	else if(type != QVariant::Bool && type != QVariant::Double && in->canConvert(QVariant::Int))
+	{
+		*in = in->toInt();
+		changed = true;
+	}
+
+	return changed;
+}
+
+QVariant convertFromJsonStyle(const QVariant &in)
+{
+	QVariant v = in;
+	convertFromJsonStyleInPlace(&v);
+	return v;
+}
+
+// strict decimal integer parse, without the allocation QByteArray::toInt
+//   needs for non-terminated data
+static bool parseInt(const char *p, int size, int *out)
+{
+	if(size < 1)
+		return false;
+
+	bool neg = false;
+	if(*p == '-')
+	{
+		neg = true;
+		++p;
+		--size;
+		if(size < 1)
+			return false;
+	}
+
+	qint64 x = 0;
+	for(int n = 0; n < size; ++n)
+	{
+		char c = p[n];
+		if(c < '0' || c > '9')
+			return false;
+
+		x = x * 10 + (c - '0');
+		if(x > (qint64)0x80000000LL)
+			return false;
+	}
+
+	if(neg)
+		x = -x;
+
+	if(x < -(qint64)0x80000000LL || x > 0x7fffffffLL)
+		return false;
+
+	*out = (int)x;
+	return true;
+}
+
+static bool isValidUtf8(const unsigned char *p, int size)
+{
+	int n = 0;
+	while(n < size)
+	{
+		unsigned char c = p[n];
+		int extra;
+		quint32 min;
+		if(c < 0x80)
+		{
+			++n;
+			continue;
+		}
+		else if((c & 0xe0) == 0xc0)
+		{
+			extra = 1;
+			min = 0x80;
+		}
+		else if((c & 0xf0) == 0xe0)
+		{
+			extra = 2;
+			min = 0x800;
+		}
+		else if((c & 0xf8) == 0xf0)
+		{
+			extra = 3;
+			min = 0x10000;
+		}
+		else
+			return false;
+
+		if(n + extra >= size)
+			return false;
+
+		quint32 cp = c & (0x3f >> extra);
+		for(int k = 1; k <= extra; ++k)
+		{
+			unsigned char cc = p[n + k];
+			if((cc & 0xc0) != 0x80)
+				return false;
+			cp = (cp << 6) | (cc & 0x3f);
+		}
+
+		if(cp < min || cp > 0x10ffff || (cp >= 0xd800 && cp <= 0xdfff))
+			return false;
+
+		n += extra + 1;
+	}
+
+	return true;
+}
+
+// reads a tnetstring in place. values are addressed by the header of the
+//   current item, and containers are tracked by their end offsets
+class TnetReader
+{
+public:
+	const QByteArray &buf;
+	const char *data;
+	int size;
+	int pos;
+	char curTag;
+	int curDataOffset;
+	int curDataSize;
+	QVarLengthArray<int, 8> ends;
+	bool failed;
+
+	TnetReader(const QByteArray &_buf, int offset) :
+		buf(_buf),
+		data(_buf.constData()),
+		size(_buf.size()),
+		pos(offset),
+		curTag(0),
+		curDataOffset(0),
+		curDataSize(0),
+		failed(false)
+	{
+		if(!check())
+			failed = true;
+	}
+
+	// parse the item header at pos
+	bool check()
+	{
+		int at = pos;
+		int len = 0;
+		int digits = 0;
+		while(at < size && data[at] != ':')
+		{
+			char c = data[at];
+			if(c < '0' || c > '9' || digits >= 9)
+				return false;
+
+			len = len * 10 + (c - '0');
+			++digits;
+			++at;
+		}
+
+		if(at >= size || digits == 0)
+			return false;
+
+		++at; // skip ':'
+
+		// need room for the payload and the type tag
+		if(len > size - at - 1)
+			return false;
+
+		curDataOffset = at;
+		curDataSize = len;
+		curTag = data[at + len];
+		return true;
+	}
+
+	int itemEnd() const
+	{
+		return curDataOffset + curDataSize + 1;
+	}
+
+	ValueType type() const
+	{
+		switch(curTag)
+		{
+			case ',': return BytesValue;
+			case '#': return IntValue;
+			case '^': return DoubleValue;
+			case '!': return BoolValue;
+			case '~': return NullValue;
+			case ']': return ListValue;
+			case '}': return MapValue;
+			default: return InvalidValue;
+		}
+	}
+
+	bool atEnd() const
+	{
+		return (!failed && pos == size);
+	}
+
+	bool beginContainer(char tag)
+	{
+		if(failed || curTag != tag || ends.count() >= MAX_NESTING_DEPTH)
+			return false;
+
+		ends.append(curDataOffset + curDataSize);
+		pos = curDataOffset;
+		return true;
+	}
+
+	// return false at end of container or on error
+	bool nextValue()
+	{
+		if(failed || ends.isEmpty())
+			return false;
+
+		int end = ends.last();
+		if(pos == end)
+		{
+			ends.removeLast();
+			pos = end + 1; // skip the container's tag
+			return false;
+		}
+
+		if(pos > end || !check() || itemEnd() > end)
+		{
+			failed = true;
+			return false;
+		}
+
+		return true;
+	}
+
+	bool beginMap()
+	{
+		return beginContainer('}');
+	}
+
+	bool beginList()
+	{
+		return beginContainer(']');
+	}
+
+	bool nextEntry(const char **key, int *keySize)
+	{
+		if(!nextValue())
+			return false;
+
+		if(curTag != ',')
+		{
+			failed = true;
+			return false;
+		}
+
+		*key = data + curDataOffset;
+		*keySize = curDataSize;
+		pos = itemEnd();
+
+		if(!nextValue())
+		{
+			// key without value
+			failed = true;
+			return false;
+		}
+
+		return true;
+	}
+
+	bool nextItem()
+	{
+		return nextValue();
+	}
+
+	bool skip()
+	{
+		pos = itemEnd();
+		return true;
+	}
+
+	// like skip(), but walks into containers to enforce the depth limit
+	bool skipNested()
+	{
+		if(curTag != ']' && curTag != '}')
+			return skip();
+
+		if(!beginContainer(curTag))
+			return false;
+
+		while(nextValue())
+		{
+			if(!skipNested())
+				return false;
+		}
+
+		return !failed;
+	}
+
+	bool readBytes(QByteArray *out)
+	{
+		if(curTag != ',')
+			return false;
+
+		*out = QByteArray(data + curDataOffset, curDataSize);
+		return skip();
+	}
+
+	bool readInt(int *out)
+	{
+		if(curTag != '#' || !parseInt(data + curDataOffset, curDataSize, out))
+			return false;
+
+		return skip();
+	}
+
+	bool readBool(bool *out)
+	{
+		if(curTag != '!')
+			return false;
+
+		if(curDataSize == 4 && memcmp(data + curDataOffset, "true", 4) == 0)
+			*out = true;
+		else if(curDataSize == 5 && memcmp(data + curDataOffset, "false", 5) == 0)
+			*out = false;
+		else
+			return false;
+
+		return skip();
+	}
+
+	bool readVariant(QVariant *out)
+	{
+		int start = pos;
+		if(!skipNested())
+			return false;
+
+		bool ok;
+		*out = TnetString::toVariant(buf, start, &ok);
+		return ok;
+	}
+};
+
+// reads json in place. strings that need no unescaping are decoded with a
+//   single copy
+class JsonReader
+{
+public:
+	const QByteArray &buf;
+	const char *data;
+	int size;
+	int pos;
+	QVarLengthArray<bool, 8> firsts;
+	QByteArray keyBuf;
+	bool failed;
+
+	JsonReader(const QByteArray &_buf, int offset) :
+		buf(_buf),
+		data(_buf.constData()),
+		size(_buf.size()),
+		pos(offset),
+		failed(false)
+	{
+		skipWs();
+		if(pos >= size)
+			failed = true;
+	}
+
+	void skipWs()
+	{
+		while(pos < size && (data[pos] == ' ' || data[pos] == '\t' || data[pos] == '\n' || data[pos] == '\r'))
+			++pos;
+	}
+
+	bool expect(const char *s, int len)
+	{
+		if(size - pos < len || memcmp(data + pos, s, len) != 0)
+			return false;
+
+		pos += len;
+		return true;
+	}
+
+	ValueType type() const
+	{
+		if(pos >= size)
+			return InvalidValue;
+
+		char c = data[pos];
+		if(c == '"')
+			return BytesValue;
+		else if(c == '{')
+			return MapValue;
+		else if(c == '[')
+			return ListValue;
+		else if(c == 't' || c == 'f')
+			return BoolValue;
+		else if(c == 'n')
+			return NullValue;
+		else if(c == '-' || (c >= '0' && c <= '9'))
+			return IntValue; // possibly not integral, checked on read
+		else
+			return InvalidValue;
+	}
+
+	bool atEnd()
+	{
+		if(failed)
+			return false;
+
+		skipWs();
+		return (pos == size);
+	}
+
+	bool beginContainer(char open)
+	{
+		if(failed || pos >= size || data[pos] != open || firsts.count() >= MAX_NESTING_DEPTH)
+			return false;
+
+		++pos;
+		firsts.append(true);
+		return true;
+	}
+
+	// return false at end of container or on error. leaves pos at the
+	//   next key or value
+	bool nextValue(char close)
+	{
+		if(failed || firsts.isEmpty())
+			return false;
+
+		skipWs();
+		if(pos >= size)
+		{
+			failed = true;
+			return false;
+		}
+
+		if(data[pos] == close)
+		{
+			++pos;
+			firsts.removeLast();
+			return false;
+		}
+
+		if(!firsts.last())
+		{
+			if(data[pos] != ',')
+			{
+				failed = true;
+				return false;
+			}
+
+			++pos;
+			skipWs();
+		}
+
+		firsts.last() = false;
+		return true;
+	}
+
+	bool beginMap()
+	{
+		return beginContainer('{');
+	}
+
+	bool beginList()
+	{
+		return beginContainer('[');
+	}
+
+	bool nextEntry(const char **key, int *keySize)
+	{
+		if(!nextValue('}'))
+			return false;
+
+		if(!readString(&keyBuf))
+		{
+			failed = true;
+			return false;
+		}
+
+		skipWs();
+		if(pos >= size || data[pos] != ':')
+		{
+			failed = true;
+			return false;
+		}
+
+		++pos;
+		skipWs();
+
+		*key = keyBuf.constData();
+		*keySize = keyBuf.size();
+		return true;
+	}
+
+	bool nextItem()
+	{
+		return nextValue(']');
+	}
+
+	static int hexValue(char c)
+	{
+		if(c >= '0' && c <= '9')
+			return c - '0';
+		else if(c >= 'a' && c <= 'f')
+			return c - 'a' + 10;
+		else if(c >= 'A' && c <= 'F')
+			return c - 'A' + 10;
+		else
+			return -1;
+	}
+
+	bool readHex4(quint32 *out)
+	{
+		if(size - pos < 4)
+			return false;
+
+		quint32 x = 0;
+		for(int n = 0; n < 4; ++n)
+		{
+			int v = hexValue(data[pos + n]);
+			if(v < 0)
+				return false;
+			x = (x << 4) | v;
+		}
+
+		pos += 4;
+		*out = x;
+		return true;
+	}
+
+	static void appendUtf8(QByteArray *out, quint32 cp)
+	{
+		if(cp < 0x80)
+		{
+			out->append((char)cp);
+		}
+		else if(cp < 0x800)
+		{
+			out->append((char)(0xc0 | (cp >> 6)));
+			out->append((char)(0x80 | (cp & 0x3f)));
+		}
+		else if(cp < 0x10000)
+		{
+			out->append((char)(0xe0 | (cp >> 12)));
+			out->append((char)(0x80 | ((cp >> 6) & 0x3f)));
+			out->append((char)(0x80 | (cp & 0x3f)));
+		}
+		else
+		{
+			out->append((char)(0xf0 | (cp >> 18)));
+			out->append((char)(0x80 | ((cp >> 12) & 0x3f)));
+			out->append((char)(0x80 | ((cp >> 6) & 0x3f)));
+			out->append((char)(0x80 | (cp & 0x3f)));
+		}
+	}
+
+	// out may be null to only validate
+	bool readString(QByteArray *out)
+	{
+		if(pos >= size || data[pos] != '"')
+			return false;
+
+		++pos;
+
+		// fast path: no escapes
+		int start = pos;
+		bool highBytes = false;
+		while(pos < size && data[pos] != '"' && data[pos] != '\\')
+		{
+			unsigned char c = (unsigned char)data[pos];
+			if(c < 0x20)
+				return false;
+			if(c >= 0x80)
+				highBytes = true;
+			++pos;
+		}
+
+		if(pos >= size)
+			return false;
+
+		// invalid utf-8 would have been replaced by the variant path, so
+		//   leave those strings to it
+		if(highBytes && !isValidUtf8((const unsigned char *)data + start, pos - start))
+			return false;
+
+		if(data[pos] == '"')
+		{
+			if(out)
+				*out = QByteArray(data + start, pos - start);
+			++pos;
+			return true;
+		}
+
+		// slow path: unescape
+		QByteArray tmp(data + start, pos - start);
+		while(true)
+		{
+			if(pos >= size)
+				return false;
+
+			char c = data[pos];
+			if(c == '"')
+			{
+				++pos;
+				break;
+			}
+
+			if((unsigned char)c < 0x20)
+				return false;
+
+			if(c != '\\')
+			{
+				int segStart = pos;
+				while(pos < size && data[pos] != '"' && data[pos] != '\\' && (unsigned char)data[pos] >= 0x20)
+					++pos;
+
+				if(!isValidUtf8((const unsigned char *)data + segStart, pos - segStart))
+					return false;
+
+				tmp.append(data + segStart, pos - segStart);
+				continue;
+			}
+
+			++pos;
+			if(pos >= size)
+				return false;
+
+			c = data[pos++];
+			switch(c)
+			{
+				case '"': tmp += '"'; break;
+				case '\\': tmp += '\\'; break;
+				case '/': tmp += '/'; break;
+				case 'b': tmp += '\b'; break;
+				case 'f': tmp += '\f'; break;
+				case 'n': tmp += '\n'; break;
+				case 'r': tmp += '\r'; break;
+				case 't': tmp += '\t'; break;
+				case 'u':
+				{
+					quint32 cp;
+					if(!readHex4(&cp))
+						return false;
+
+					if(cp >= 0xd800 && cp <= 0xdbff)
+					{
+						quint32 low;
+						if(!expect("\\u", 2) || !readHex4(&low) || low < 0xdc00 || low > 0xdfff)
+							return false;
+
+						cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+					}
+					else if(cp >= 0xdc00 && cp <= 0xdfff)
+					{
+						return false;
+					}
+
+					appendUtf8(&tmp, cp);
+					break;
+				}
+				default:
+					return false;
+			}
+		}
+
+		if(out)
+			*out = tmp;
+		return true;
+	}
+
+	// validates a json number. isIntegral is set if there is no fraction
+	//   or exponent
+	bool scanNumber(int *start, int *len, bool *isIntegral)
+	{
+		*start = pos;
+		*isIntegral = true;
+
+		if(pos < size && data[pos] == '-')
+			++pos;
+
+		if(pos >= size)
+			return false;
+
+		if(data[pos] == '0')
+		{
+			++pos;
+		}
+		else if(data[pos] >= '1' && data[pos] <= '9')
+		{
+			while(pos < size && data[pos] >= '0' && data[pos] <= '9')
+				++pos;
+		}
+		else
+			return false;
+
+		if(pos < size && data[pos] == '.')
+		{
+			*isIntegral = false;
+			++pos;
+			int digitsStart = pos;
+			while(pos < size && data[pos] >= '0' && data[pos] <= '9')
+				++pos;
+			if(pos == digitsStart)
+				return false;
+		}
+
+		if(pos < size && (data[pos] == 'e' || data[pos] == 'E'))
+		{
+			*isIntegral = false;
+			++pos;
+			if(pos < size && (data[pos] == '+' || data[pos] == '-'))
+				++pos;
+			int digitsStart = pos;
+			while(pos < size && data[pos] >= '0' && data[pos] <= '9')
+				++pos;
+			if(pos == digitsStart)
+				return false;
+		}
+
+		*len = pos - *start;
+		return true;
+	}
+
+	bool skip()
+	{
+		switch(type())
+		{
+			case BytesValue:
+				return readString(0);
+			case IntValue:
+			{
+				int start, len;
+				bool isIntegral;
+				return scanNumber(&start, &len, &isIntegral);
+			}
+			case BoolValue:
+				return (expect("true", 4) || expect("false", 5));
+			case NullValue:
+				return expect("null", 4);
+			case ListValue:
+			{
+				if(!beginList())
+					return false;
+				while(nextItem())
+				{
+					if(!skip())
+						return false;
+				}
+				return !failed;
+			}
+			case MapValue:
+			{
+				if(!beginMap())
+					return false;
+				const char *key;
+				int keySize;
+				while(nextEntry(&key, &keySize))
+				{
+					if(!skip())
+						return false;
+				}
+				return !failed;
+			}
+			default:
+				return false;
+		}
+	}
+
+	bool readBytes(QByteArray *out)
+	{
+		return readString(out);
+	}
+
+	bool readInt(int *out)
+	{
+		if(type() != IntValue)
+			return false;
+
+		int start, len;
+		bool isIntegral;
+		if(!scanNumber(&start, &len, &isIntegral) || !isIntegral)
+			return false;
+
+		return parseInt(data + start, len, out);
+	}
+
+	bool readBool(bool *out)
+	{
+		if(expect("true", 4))
+			*out = true;
+		else if(expect("false", 5))
+			*out = false;
+		else
+			return false;
+
+		return true;
+	}
+
+	bool readVariant(QVariant *out)
+	{
+		// arbitrary values are rare (only user-data), so convert them
+		//   the same way the variant path does, for identical results
+		int start = pos;
+		if(!skip())
+			return false;
+
+		QByteArray wrapped;
+		wrapped.reserve(pos - start + 2);
+		wrapped += '[';
+		wrapped.append(data + start, pos - start);
+		wrapped += ']';
+
+		QJsonParseError e;
+		QJsonDocument doc = QJsonDocument::fromJson(wrapped, &e);
+		if(e.error != QJsonParseError::NoError || !doc.isArray())
+			return false;
+
+		*out = convertFromJsonStyle(doc.array().toVariantList().value(0));
+		return true;
+	}
+};
+
+static bool keyIs(const char *key, int keySize, const char *name)
+{
+	int len = strlen(name);
+	return (keySize == len && memcmp(key, name, len) == 0);
+}
+
+template <typename Reader>
+static bool readId(Reader *r, ZhttpRequestPacket::Id *id)
+{
+	if(r->type() != MapValue || !r->beginMap())
+		return false;
+
+	bool haveId = false;
+	const char *key;
+	int keySize;
+	while(r->nextEntry(&key, &keySize))
+	{
+		if(keyIs(key, keySize, "id"))
+		{
+			if(!r->readBytes(&id->id))
+				return false;
+			haveId = true;
+		}
+		else if(keyIs(key, keySize, "seq"))
+		{
+			if(!r->readInt(&id->seq))
+				return false;
+		}
+		else
+		{
+			if(!r->skip())
+				return false;
+		}
+	}
+
+	return (!r->failed && haveId);
+}
+
+template <typename Reader>
+static bool readHeaders(Reader *r, HttpHeaders *headers)
+{
+	if(r->type() != ListValue || !r->beginList())
+		return false;
+
+	while(r->nextItem())
+	{
+		if(r->type() != ListValue || !r->beginList())
+			return false;
+
+		QByteArray parts[2];
+		int count = 0;
+		while(r->nextItem())
+		{
+			if(count >= 2 || !r->readBytes(&parts[count]))
+				return false;
+			++count;
+		}
+
+		if(r->failed || count != 2)
+			return false;
+
+		*headers += HttpHeader(parts[0], parts[1]);
+	}
+
+	return !r->failed;
+}
+
+template <typename Reader>
+static bool readType(Reader *r, ZhttpRequestPacket::Type *type)
+{
+	QByteArray s;
+	if(!r->readBytes(&s))
+		return false;
+
+	if(s == "error")
+		*type = ZhttpRequestPacket::Error;
+	else if(s == "credit")
+		*type = ZhttpRequestPacket::Credit;
+	else if(s == "keep-alive")
+		*type = ZhttpRequestPacket::KeepAlive;
+	else if(s == "cancel")
+		*type = ZhttpRequestPacket::Cancel;
+	else if(s == "close")
+		*type = ZhttpRequestPacket::Close;
+	else if(s == "ping")
+		*type = ZhttpRequestPacket::Ping;
+	else if(s == "pong")
+		*type = ZhttpRequestPacket::Pong;
+	else
+		return false; // leave anything else to the variant path
+
+	return true;
+}
+
+template <typename Reader>
+static bool readRequest(Reader *r, ZhttpRequestPacket *p, RequestExtras *extras)
+{
+	if(r->failed || r->type() != MapValue || !r->beginMap())
+		return false;
+
+	*p = ZhttpRequestPacket();
+
+	QByteArray singleId;
+	bool haveSingleId = false;
+	int singleSeq = -1;
+	QList<ZhttpRequestPacket::Id> idList;
+	bool haveIdList = false;
+
+	const char *key;
+	int keySize;
+	while(r->nextEntry(&key, &keySize))
+	{
+		bool ok;
+
+		if(keyIs(key, keySize, "from"))
+		{
+			ok = r->readBytes(&p->from);
+		}
+		else if(keyIs(key, keySize, "id"))
+		{
+			if(r->type() == BytesValue)
+			{
+				ok = r->readBytes(&singleId);
+				haveSingleId = true;
+				haveIdList = false;
+			}
+			else if(r->type() == ListValue)
+			{
+				idList.clear();
+				ok = r->beginList();
+				while(ok && r->nextItem())
+				{
+					ZhttpRequestPacket::Id id;
+					ok = readId(r, &id);
+					if(ok)
+						idList += id;
+				}
+				ok = (ok && !r->failed);
+				haveIdList = true;
+				haveSingleId = false;
+			}
+			else
+				ok = false;
+		}
+		else if(keyIs(key, keySize, "seq"))
+		{
+			ok = r->readInt(&singleSeq);
+		}
+		else if(keyIs(key, keySize, "type"))
+		{
+			ok = readType(r, &p->type);
+		}
+		else if(keyIs(key, keySize, "credits"))
+		{
+			ok = r->readInt(&p->credits);
+		}
+		else if(keyIs(key, keySize, "more"))
+		{
+			ok = r->readBool(&p->more);
+		}
+		else if(keyIs(key, keySize, "stream"))
+		{
+			ok = r->readBool(&p->stream);
+		}
+		else if(keyIs(key, keySize, "max-size"))
+		{
+			ok = r->readInt(&p->maxSize);
+		}
+		else if(keyIs(key, keySize, "timeout"))
+		{
+			ok = r->readInt(&p->timeout);
+		}
+		else if(keyIs(key, keySize, "method"))
+		{
+			QByteArray s;
+			ok = r->readBytes(&s);
+			if(ok)
+				p->method = QString::fromLatin1(s);
+		}
+		else if(keyIs(key, keySize, "uri"))
+		{
+			QByteArray s;
+			ok = r->readBytes(&s);
+			if(ok)
+			{
+				p->uri = QUrl::fromEncoded(s, QUrl::StrictMode);
+				ok = p->uri.isValid();
+			}
+		}
+		else if(keyIs(key, keySize, "headers"))
+		{
+			p->headers.clear();
+			ok = readHeaders(r, &p->headers);
+		}
+		else if(keyIs(key, keySize, "body"))
+		{
+			ok = r->readBytes(&p->body);
+		}
+		else if(keyIs(key, keySize, "content-type"))
+		{
+			ok = r->readBytes(&p->contentType);
+		}
+		else if(keyIs(key, keySize, "code"))
+		{
+			ok = r->readInt(&p->code);
+		}
+		else if(keyIs(key, keySize, "user-data"))
+		{
+			ok = r->readVariant(&p->userData);
+		}
+		else if(keyIs(key, keySize, "connect-host"))
+		{
+			QByteArray s;
+			ok = r->readBytes(&s);
+			if(ok)
+				p->connectHost = QString::fromUtf8(s);
+		}
+		else if(keyIs(key, keySize, "connect-port"))
+		{
+			ok = r->readInt(&p->connectPort);
+		}
+		else if(keyIs(key, keySize, "ignore-policies"))
+		{
+			ok = r->readBool(&p->ignorePolicies);
+		}
+		else if(keyIs(key, keySize, "trust-connect-host"))
+		{
+			ok = r->readBool(&p->trustConnectHost);
+		}
+		else if(keyIs(key, keySize, "ignore-tls-errors"))
+		{
+			ok = r->readBool(&p->ignoreTlsErrors);
+		}
+		else if(keyIs(key, keySize, "follow-redirects"))
+		{
+			ok = r->readBool(&p->followRedirects);
+		}
+		else if(keyIs(key, keySize, "quiet"))
+		{
+			ok = r->readBool(&p->quiet);
+		}
+		else if(keyIs(key, keySize, "multi"))
+		{
+			ok = r->readBool(&p->multi);
+		}
+		else if(keyIs(key, keySize, "http-version"))
+		{
+			QByteArray s;
+			ok = r->readBytes(&s);
+			if(ok && extras)
+				extras->httpVersion = s;
+		}
+		else if(keyIs(key, keySize, "prewarm"))
+		{
+			bool b;
+			ok = r->readBool(&b);
+			if(ok && extras)
+				extras->prewarm = b;
+		}
+		else if(keyIs(key, keySize, "prewarm-count"))
+		{
+			int x;
+			ok = r->readInt(&x);
+			if(ok && extras)
+				extras->prewarmCount = x;
+		}
+		else if(keyIs(key, keySize, "decode-content"))
+		{
+			bool b;
+			ok = r->readBool(&b);
+			if(ok && extras)
+				extras->decodeContent = b;
+		}
+		else if(keyIs(key, keySize, "flush-size"))
+		{
+			int x;
+			ok = r->readInt(&x);
+			if(ok && extras)
+				extras->flushSize = x;
+		}
+		else if(keyIs(key, keySize, "flush-delay-ms"))
+		{
+			int x;
+			ok = r->readInt(&x);
+			if(ok && extras)
+				extras->flushDelay = x;
+		}
+		else
+		{
+			// unknown field. let the variant path decide what to do
+			ok = false;
+		}
+
+		if(!ok)
+			return false;
+	}
+
+	if(r->failed || !r->atEnd())
+		return false;
+
+	if(haveSingleId)
+		p->ids += ZhttpRequestPacket::Id(singleId, singleSeq);
+	else if(haveIdList)
+		p->ids = idList;
+
+	return true;
+}
+
+bool parseRequest(const QByteArray &message, ZhttpRequestPacket *packet, RequestExtras *extras)
+{
+	if(message.isEmpty())
+		return false;
+
+	if(extras)
+		*extras = RequestExtras();
+
+	if(message[0] == 'T')
+	{
+		TnetReader r(message, 1);
+		return readRequest(&r, packet, extras);
+	}
+	else if(message[0] == 'J')
+	{
+		JsonReader r(message, 1);
+		return readRequest(&r, packet, extras);
+	}
+	else
+		return false;
+}
+
+// json numbers decode as doubles
+static bool isNumber(const QVariant &v)
+{
+	return (v.type() == QVariant::Int || v.type() == QVariant::LongLong || v.type() == QVariant::Double);
+}
+
+RequestExtras requestExtrasFromVariant(const QVariant &in)
+{
+	RequestExtras extras;
+
+	if(in.type() == QVariant::Hash)
+	{
+		QVariantHash obj = in.toHash();
+
+		QVariant vversion = obj.value("http-version");
+		if(vversion.type() == QVariant::ByteArray)
+			extras.httpVersion = vversion.toByteArray();
+
+		QVariant vprewarm = obj.value("prewarm");
+		if(vprewarm.type() == QVariant::Bool)
+			extras.prewarm = vprewarm.toBool();
+
+		QVariant vprewarmCount = obj.value("prewarm-count");
+		if(isNumber(vprewarmCount))
+			extras.prewarmCount = vprewarmCount.toInt();
+
+		QVariant vdecodeContent = obj.value("decode-content");
+		if(vdecodeContent.type() == QVariant::Bool)
+			extras.decodeContent = vdecodeContent.toBool();
+
+		QVariant vflushSize = obj.value("flush-size");
+		if(isNumber(vflushSize))
+			extras.flushSize = vflushSize.toInt();
+
+		QVariant vflushDelay = obj.value("flush-delay-ms");
+		if(isNumber(vflushDelay))
+			extras.flushDelay = vflushDelay.toInt();
+	}
+
+	return extras;
+}
+
+
+// sinks for the serializers. everything is written twice, once to find
+//   the size and once into the preallocated buffer
+
+class SizeSink
+{
+public:
+	int size;
+
+	SizeSink() :
+		size(0)
+	{
+	}
+
+	void append(char)
+	{
+		++size;
+	}
+
+	void append(const char *, int len)
+	{
+		size += len;
+	}
+
+	void append(const QByteArray &buf)
+	{
+		size += buf.size();
+	}
+};
+
+class BufferSink
+{
+public:
+	char *p;
+
+	BufferSink(char *_p) :
+		p(_p)
+	{
+	}
+
+	void append(char c)
+	{
+		*(p++) = c;
+	}
+
+	void append(const char *s, int len)
+	{
+		memcpy(p, s, len);
+		p += len;
+	}
+
+	void append(const QByteArray &buf)
+	{
+		append(buf.constData(), buf.size());
+	}
+};
+
+// buf must have room for 11 chars
+static int formatInt(char *buf, int x)
+{
+	char tmp[16];
+	int len = 0;
+
+	quint32 ux = (x < 0 ? (quint32)0 - (quint32)x : (quint32)x);
+	do
+	{
+		tmp[len++] = '0' + (ux % 10);
+		ux /= 10;
+	} while(ux > 0);
+
+	int n = 0;
+	if(x < 0)
+		buf[n++] = '-';
+
+	while(len > 0)
+		buf[n++] = tmp[--len];
+
+	return n;
+}
+
+static const char *responseTypeToString(ZhttpResponsePacket::Type type)
+{
+	switch(type)
+	{
+		case ZhttpResponsePacket::Error: return "error";
+		case ZhttpResponsePacket::Credit: return "credit";
+		case ZhttpResponsePacket::KeepAlive: return "keep-alive";
+		case ZhttpResponsePacket::Cancel: return "cancel";
+		case ZhttpResponsePacket::Close: return "close";
+		case ZhttpResponsePacket::Ping: return "ping";
+		case ZhttpResponsePacket::Pong: return "pong";
+		default: return 0;
+	}
+}
+
+// tnetstring
+
+template <typename Sink>
+static void tnetItem(Sink *s, const char *data, int size, char tag)
+{
+	char buf[16];
+	int n = formatInt(buf, size);
+	s->append(buf, n);
+	s->append(':');
+	s->append(data, size);
+	s->append(tag);
+}
+
+template <typename Sink>
+static void tnetBytes(Sink *s, const QByteArray &buf)
+{
+	tnetItem(s, buf.constData(), buf.size(), ',');
+}
+
+template <typename Sink>
+static void tnetKey(Sink *s, const char *key)
+{
+	tnetItem(s, key, strlen(key), ',');
+}
+
+template <typename Sink>
+static void tnetInt(Sink *s, int x)
+{
+	char buf[16];
+	int n = formatInt(buf, x);
+	tnetItem(s, buf, n, '#');
+}
+
+template <typename Sink>
+static void tnetTrue(Sink *s)
+{
+	s->append("4:true!", 7);
+}
+
+template <typename Sink>
+static void tnetContainerHeader(Sink *s, int size)
+{
+	char buf[16];
+	int n = formatInt(buf, size);
+	s->append(buf, n);
+	s->append(':');
+}
+
+template <typename Sink>
+static void tnetIdMapBody(Sink *s, const ZhttpResponsePacket::Id &id)
+{
+	if(!id.id.isEmpty())
+	{
+		tnetKey(s, "id");
+		tnetBytes(s, id.id);
+	}
+
+	if(id.seq != -1)
+	{
+		tnetKey(s, "seq");
+		tnetInt(s, id.seq);
+	}
+}
+
+template <typename Sink>
+static void tnetIdListBody(Sink *s, const QList<ZhttpResponsePacket::Id> &ids)
+{
+	foreach(const ZhttpResponsePacket::Id &id, ids)
+	{
+		SizeSink c;
+		tnetIdMapBody(&c, id);
+		tnetContainerHeader(s, c.size);
+		tnetIdMapBody(s, id);
+		s->append('}');
+	}
+}
+
+template <typename Sink>
+static void tnetHeaderListBody(Sink *s, const HttpHeaders &headers)
+{
+	foreach(const HttpHeader &h, headers)
+	{
+		SizeSink c;
+		tnetBytes(&c, h.first);
+		tnetBytes(&c, h.second);
+		tnetContainerHeader(s, c.size);
+		tnetBytes(s, h.first);
+		tnetBytes(s, h.second);
+		s->append(']');
+	}
+}
+
+template <typename Sink>
+static void tnetIdList(Sink *s, const QList<ZhttpResponsePacket::Id> &ids)
+{
+	SizeSink c;
+	tnetIdListBody(&c, ids);
+	tnetContainerHeader(s, c.size);
+	tnetIdListBody(s, ids);
+	s->append(']');
+}
+
+template <typename Sink>
+static void tnetHeaderList(Sink *s, const HttpHeaders &headers)
+{
+	SizeSink c;
+	tnetHeaderListBody(&c, headers);
+	tnetContainerHeader(s, c.size);
+	tnetHeaderListBody(s, headers);
+	s->append(']');
+}
+
+// userData is pre-encoded, since it can be anything
+template <typename Sink>
+static void tnetResponseBody(Sink *s, const ZhttpResponsePacket &p, const QByteArray &userData)
+{
+	if(!p.from.isEmpty())
+	{
+		tnetKey(s, "from");
+		tnetBytes(s, p.from);
+	}
+
+	if(p.ids.count() == 1)
+	{
+		tnetIdMapBody(s, p.ids.first());
+	}
+	else if(p.ids.count() > 1)
+	{
+		tnetKey(s, "id");
+		tnetIdList(s, p.ids);
+	}
+
+	const char *typeStr = responseTypeToString(p.type);
+	if(typeStr)
+	{
+		tnetKey(s, "type");
+		tnetKey(s, typeStr);
+	}
+
+	if(p.type == ZhttpResponsePacket::Error)
+	{
+		tnetKey(s, "condition");
+		tnetBytes(s, p.condition);
+	}
+	else if(p.type == ZhttpResponsePacket::Credit)
+	{
+		tnetKey(s, "credits");
+		tnetInt(s, p.credits);
+	}
+
+	if((p.type == ZhttpResponsePacket::Data || p.type == ZhttpResponsePacket::Error) && p.code != -1)
+	{
+		tnetKey(s, "code");
+		tnetInt(s, p.code);
+		tnetKey(s, "reason");
+		tnetBytes(s, p.reason);
+		tnetKey(s, "headers");
+		tnetHeaderList(s, p.headers);
+	}
+
+	if(p.type == ZhttpResponsePacket::Data || (p.type == ZhttpResponsePacket::Error && p.code != -1))
+	{
+		tnetKey(s, "body");
+		tnetBytes(s, p.body);
+	}
+
+	if(p.type == ZhttpResponsePacket::Data)
+	{
+		if(!p.contentType.isEmpty())
+		{
+			tnetKey(s, "content-type");
+			tnetBytes(s, p.contentType);
+		}
+
+		if(p.more)
+		{
+			tnetKey(s, "more");
+			tnetTrue(s);
+		}
+
+		if(p.credits != -1)
+		{
+			tnetKey(s, "credits");
+			tnetInt(s, p.credits);
+		}
+	}
+	else if(p.type == ZhttpResponsePacket::Close)
+	{
+		if(p.code != -1)
+		{
+			tnetKey(s, "code");
+			tnetInt(s, p.code);
+		}
+
+		if(!p.body.isEmpty())
+		{
+			tnetKey(s, "body");
+			tnetBytes(s, p.body);
+		}
+	}
+
+	if(p.multi)
+	{
+		tnetKey(s, "multi");
+		tnetTrue(s);
+	}
+
+	if(!userData.isEmpty())
+	{
+		tnetKey(s, "user-data");
+		s->append(userData);
+	}
+}
+
+template <typename Sink>
+static void tnetResponse(Sink *s, const ZhttpResponsePacket &p, const QByteArray &userData)
+{
+	SizeSink c;
+	tnetResponseBody(&c, p, userData);
+	tnetContainerHeader(s, c.size);
+	tnetResponseBody(s, p, userData);
+	s->append('}');
+}
+
+// json. strings are written the way QJsonDocument would write them after
+//   the byte arrays were converted with QString::fromUtf8
+
+template <typename Sink>
+static void jsonRawString(Sink *s, const char *data, int size)
+{
+	static const char *hex = "0123456789abcdef";
+
+	s->append('"');
+
+	int start = 0;
+	for(int n = 0; n < size; ++n)
+	{
+		unsigned char c = (unsigned char)data[n];
+		if(c >= 0x20 && c != '"' && c != '\\')
+			continue;
+
+		if(n > start)
+			s->append(data + start, n - start);
+		start = n + 1;
+
+		s->append('\\');
+		switch(c)
+		{
+			case '"': s->append('"'); break;
+			case '\\': s->append('\\'); break;
+			case '\b': s->append('b'); break;
+			case '\f': s->append('f'); break;
+			case '\n': s->append('n'); break;
+			case '\r': s->append('r'); break;
+			case '\t': s->append('t'); break;
+			default:
+			{
+				char buf[5] = { 'u', '0', '0', hex[c >> 4], hex[c & 0x0f] };
+				s->append(buf, 5);
+				break;
+			}
+		}
+	}
+
+	if(size > start)
+		s->append(data + start, size - start);
+
+	s->append('"');
+}
+
+template <typename Sink>
+static void jsonKey(Sink *s, bool *first, const char *key)
+{
+	if(!*first)
+		s->append(',');
+	*first = false;
+
+	jsonRawString(s, key, strlen(key));
+	s->append(':');
+}
+
+template <typename Sink>
+static void jsonBytes(Sink *s, const QByteArray &buf)
+{
+	if(isValidUtf8((const unsigned char *)buf.constData(), buf.size()))
+	{
+		jsonRawString(s, buf.constData(), buf.size());
+	}
+	else
+	{
+		// invalid sequences get replaced, same as the variant path
+		QByteArray fixed = QString::fromUtf8(buf).toUtf8();
+		jsonRawString(s, fixed.constData(), fixed.size());
+	}
+}
+
+template <typename Sink>
+static void jsonInt(Sink *s, int x)
+{
+	char buf[16];
+	int n = formatInt(buf, x);
+	s->append(buf, n);
+}
+
+template <typename Sink>
+static void jsonIdMap(Sink *s, const ZhttpResponsePacket::Id &id, bool *first)
+{
+	if(!id.id.isEmpty())
+	{
+		jsonKey(s, first, "id");
+		jsonBytes(s, id.id);
+	}
+
+	if(id.seq != -1)
+	{
+		jsonKey(s, first, "seq");
+		jsonInt(s, id.seq);
+	}
+}
+
+template <typename Sink>
+static void jsonResponse(Sink *s, const ZhttpResponsePacket &p, const QByteArray &body, const QByteArray &userData)
+{
+	bool first = true;
+
+	s->append('{');
+
+	if(!p.from.isEmpty())
+	{
+		jsonKey(s, &first, "from");
+		jsonBytes(s, p.from);
+	}
+
+	if(p.ids.count() == 1)
+	{
+		jsonIdMap(s, p.ids.first(), &first);
+	}
+	else if(p.ids.count() > 1)
+	{
+		jsonKey(s, &first, "id");
+		s->append('[');
+		for(int n = 0; n < p.ids.count(); ++n)
+		{
+			if(n > 0)
+				s->append(',');
+
+			bool idFirst = true;
+			s->append('{');
+			jsonIdMap(s, p.ids[n], &idFirst);
+			s->append('}');
+		}
+		s->append(']');
+	}
+
+	const char *typeStr = responseTypeToString(p.type);
+	if(typeStr)
+	{
+		jsonKey(s, &first, "type");
+		jsonRawString(s, typeStr, strlen(typeStr));
+	}
+
+	if(p.type == ZhttpResponsePacket::Error)
+	{
+		jsonKey(s, &first, "condition");
+		jsonBytes(s, p.condition);
+	}
+	else if(p.type == ZhttpResponsePacket::Credit)
+	{
+		jsonKey(s, &first, "credits");
+		jsonInt(s, p.credits);
+	}
+
+	if((p.type == ZhttpResponsePacket::Data || p.type == ZhttpResponsePacket::Error) && p.code != -1)
+	{
+		jsonKey(s, &first, "code");
+		jsonInt(s, p.code);
+		jsonKey(s, &first, "reason");
+		jsonBytes(s, p.reason);
+		jsonKey(s, &first, "headers");
+		s->append('[');
+		for(int n = 0; n < p.headers.count(); ++n)
+		{
+			if(n > 0)
+				s->append(',');
+
+			const HttpHeader &h = p.headers[n];
+			s->append('[');
+			jsonBytes(s, h.first);
+			s->append(',');
+			jsonBytes(s, h.second);
+			s->append(']');
+		}
+		s->append(']');
+	}
+
+	if(p.type == ZhttpResponsePacket::Data || (p.type == ZhttpResponsePacket::Error && p.code != -1))
+	{
+		jsonKey(s, &first, "body");
+		jsonRawString(s, body.constData(), body.size());
+	}
+
+	if(p.type == ZhttpResponsePacket::Data)
+	{
+		if(!p.contentType.isEmpty())
+		{
+			jsonKey(s, &first, "content-type");
+			jsonBytes(s, p.contentType);
+		}
+
+		if(p.more)
+		{
+			jsonKey(s, &first, "more");
+			s->append("true", 4);
+		}
+
+		if(p.credits != -1)
+		{
+			jsonKey(s, &first, "credits");
+			jsonInt(s, p.credits);
+		}
+	}
+	else if(p.type == ZhttpResponsePacket::Close)
+	{
+		if(p.code != -1)
+		{
+			jsonKey(s, &first, "code");
+			jsonInt(s, p.code);
+		}
+
+		if(!body.isEmpty())
+		{
+			jsonKey(s, &first, "body");
+			jsonRawString(s, body.constData(), body.size());
+		}
+	}
+
+	if(p.multi)
+	{
+		jsonKey(s, &first, "multi");
+		s->append("true", 4);
+	}
+
+	if(!userData.isEmpty())
+	{
+		jsonKey(s, &first, "user-data");
+		s->append(userData);
+	}
+
+	s->append('}');
+}
+
+QByteArray serializeResponse(const ZhttpResponsePacket &p, char format, const QByteArray &prefix)
+{
+	switch(p.type)
+	{
+		case ZhttpResponsePacket::Data:
+		case ZhttpResponsePacket::Error:
+		case ZhttpResponsePacket::Credit:
+		case ZhttpResponsePacket::KeepAlive:
+		case ZhttpResponsePacket::Cancel:
+		case ZhttpResponsePacket::Close:
+			break;
+		case ZhttpResponsePacket::Ping:
+		case ZhttpResponsePacket::Pong:
+			// only the type is sent for these. leave anything else to
+			//   the variant path
+			if(!p.body.isEmpty() || !p.contentType.isEmpty())
+				return QByteArray();
+			break;
+		default:
+			return QByteArray();
+	}
+
+	int prefixSize = (!prefix.isEmpty() ? prefix.size() + 1 : 0);
+
+	QByteArray out;
+	if(format == 'T')
+	{
+		QByteArray userData;
+		if(p.userData.isValid())
+			userData = TnetString::fromVariant(p.userData);
+
+		SizeSink c;
+		tnetResponse(&c, p, userData);
+
+		out.resize(prefixSize + 1 + c.size);
+		BufferSink w(out.data());
+		if(prefixSize > 0)
+		{
+			w.append(prefix);
+			w.append(' ');
+		}
+		w.append('T');
+		tnetResponse(&w, p, userData);
+	}
+	else if(format == 'J')
+	{
+		// bodies are checked once here rather than in both passes
+		QByteArray body = p.body;
+		if(!isValidUtf8((const unsigned char *)body.constData(), body.size()))
+			body = QString::fromUtf8(body).toUtf8();
+
+		QByteArray userData;
+		if(p.userData.isValid())
+		{
+			// wrap in an array so scalars can be encoded too
+			QJsonArray a;
+			a += QJsonValue::fromVariant(convertToJsonStyle(p.userData));
+			userData = QJsonDocument(a).toJson(QJsonDocument::Compact);
+			userData = userData.mid(1, userData.size() - 2);
+		}
+
+		SizeSink c;
+		jsonResponse(&c, p, body, userData);
+
+		out.resize(prefixSize + 1 + c.size);
+		BufferSink w(out.data());
+		if(prefixSize > 0)
+		{
+			w.append(prefix);
+			w.append(' ');
+		}
+		w.append('J');
+		jsonResponse(&w, p, body, userData);
+	}
+
+	return out;
+}
+
+}
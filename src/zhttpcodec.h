@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2026 Fanout, Inc.
+ *
+ * This file is part of Zurl.
+ *
+ * $FANOUT_BEGIN_LICENSE:GPL$
+ *
+ * Zurl is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zurl is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Zurl may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#ifndef ZHTTPCODEC_H
+#define ZHTTPCODEC_H
+
+#include <QVariant>
+
+class ZhttpRequestPacket;
+class ZhttpResponsePacket;
+
+// conversion of zhttp packets to and from the wire formats. the parse and
+//   serialize functions work on the encoded bytes directly, without
+//   building a QVariant tree. the variant helpers are what the app used
+//   before, and are kept for logging and validation
+
+namespace ZhttpCodec {
+
+// request fields specific to zurl, which ZhttpRequestPacket doesn't carry
+class RequestExtras
+{
+public:
+	QByteArray httpVersion; // "1.1", "2", "2-prior-knowledge", or empty
+	bool prewarm; // only open keep-alive connections, with HEAD requests
+	int prewarmCount; // connections to open if prewarm, -1 if not set
+	bool decodeContent;
+	int flushSize; // -1 if not set
+	int flushDelay; // msecs, -1 if not set
+
+	RequestExtras() :
+		prewarm(false),
+		prewarmCount(-1),
+		decodeContent(true),
+		flushSize(-1),
+		flushDelay(-1)
+	{
+	}
+
+	bool operator==(const RequestExtras &other) const
+	{
+		return (httpVersion == other.httpVersion && prewarm == other.prewarm && prewarmCount == other.prewarmCount && decodeContent == other.decodeContent && flushSize == other.flushSize && flushDelay == other.flushDelay);
+	}
+
+	bool operator!=(const RequestExtras &other) const
+	{
+		return !(*this == other);
+	}
+};
+
+// message includes the format prefix ('T' or 'J'). returns false for
+//   anything not in the canonical encoding, including fields zurl doesn't
+//   know about. callers should fall back to the variant path in that case
+//   so validation and error handling stay the same
+bool parseRequest(const QByteArray &message, ZhttpRequestPacket *packet, RequestExtras *extras = 0);
+
+// reads the extras from a request decoded the variant way
+RequestExtras requestExtrasFromVariant(const QVariant &in);
+
+// format is the wire prefix, 'T' or 'J'. if prefix is not empty, it is
+//   written first followed by a space, for pub-sub routing. the result is
+//   built in a single allocation. returns an empty array for packets the
+//   serializer doesn't handle, in which case callers should use the
+//   variant path
+QByteArray serializeResponse(const ZhttpResponsePacket &packet, char format, const QByteArray &prefix = QByteArray());
+
+// Hash -> Map, ByteArray (UTF-8) -> String
+QVariant convertToJsonStyle(const QVariant &in);
+
+// Map -> Hash, String -> ByteArray (UTF-8)
+QVariant convertFromJsonStyle(const QVariant &in);
+
+}
+
+#endif
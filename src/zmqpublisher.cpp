@@ -0,0 +1,149 @@
+/*
+ * Copyright (C) 2026 Fanout, Inc.
+ *
+ * This file is part of Zurl.
+ *
+ * $FANOUT_BEGIN_LICENSE:GPL$
+ *
+ * Zurl is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zurl is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Zurl may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#include "zmqpublisher.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <string.h>
+#include <zmq.h>
+#include "logutil.h"
+
+// below this, copying is cheaper than the extra allocation for the
+//   shared reference
+#define ZERO_COPY_MIN 4096
+
+static void releaseBuffer(void *data, void *hint)
+{
+	Q_UNUSED(data);
+
+	// may be called from a libzmq thread. QByteArray's reference count
+	//   is atomic, so this is safe
+	delete (QByteArray *)hint;
+}
+
+class ZmqPublisher::Private : public QObject
+{
+	Q_OBJECT
+
+public:
+	ZmqPublisher *q;
+	void *context;
+	bool ownContext;
+	void *sock;
+
+	Private(ZmqPublisher *_q, void *_context) :
+		QObject(_q),
+		q(_q),
+		context(_context),
+		ownContext(false)
+	{
+		if(!context)
+		{
+			context = zmq_ctx_new();
+			assert(context);
+			ownContext = true;
+		}
+
+		sock = zmq_socket(context, ZMQ_PUB);
+		assert(sock);
+
+		// don't hold up shutdown for unsent messages
+		int linger = 0;
+		zmq_setsockopt(sock, ZMQ_LINGER, &linger, sizeof(linger));
+	}
+
+	~Private()
+	{
+		zmq_close(sock);
+
+		if(ownContext)
+			zmq_ctx_term(context);
+	}
+
+	void write(const QByteArray &buf)
+	{
+		zmq_msg_t msg;
+
+		if(buf.size() >= ZERO_COPY_MIN)
+		{
+			QByteArray *ref = new QByteArray(buf);
+			int ret = zmq_msg_init_data(&msg, (void *)ref->constData(), ref->size(), releaseBuffer, ref);
+			assert(ret == 0);
+		}
+		else
+		{
+			int ret = zmq_msg_init_size(&msg, buf.size());
+			assert(ret == 0);
+			memcpy(zmq_msg_data(&msg), buf.constData(), buf.size());
+		}
+
+		if(zmq_msg_send(&msg, sock, ZMQ_DONTWAIT) == -1)
+		{
+			// on failure the message is still ours
+			if(errno != EAGAIN)
+				log_debug("zmq publish failed: %s", zmq_strerror(errno));
+
+			zmq_msg_close(&msg);
+		}
+	}
+};
+
+ZmqPublisher::ZmqPublisher(QObject *parent) :
+	QObject(parent)
+{
+	d = new Private(this, 0);
+}
+
+ZmqPublisher::ZmqPublisher(void *context, QObject *parent) :
+	QObject(parent)
+{
+	d = new Private(this, context);
+}
+
+ZmqPublisher::~ZmqPublisher()
+{
+	delete d;
+}
+
+void ZmqPublisher::setHwm(int hwm)
+{
+	zmq_setsockopt(d->sock, ZMQ_SNDHWM, &hwm, sizeof(hwm));
+}
+
+bool ZmqPublisher::bind(const QString &spec)
+{
+	return (zmq_bind(d->sock, spec.toUtf8().data()) == 0);
+}
+
+void ZmqPublisher::write(const QByteArray &buf)
+{
+	d->write(buf);
+}
+
+#include "zmqpublisher.moc"
@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2026 Fanout, Inc.
+ *
+ * This file is part of Zurl.
+ *
+ * $FANOUT_BEGIN_LICENSE:GPL$
+ *
+ * Zurl is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zurl is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Zurl may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#ifndef ZMQPUBLISHER_H
+#define ZMQPUBLISHER_H
+
+#include <QObject>
+
+// a PUB socket that hands message buffers to libzmq by reference rather
+//   than copying them. writes never block: like a QZmq::Socket with the
+//   write queue disabled, messages are dropped if a subscriber is at its
+//   high water mark. publishers should share a context, so that each
+//   doesn't start its own libzmq i/o thread
+
+class ZmqPublisher : public QObject
+{
+	Q_OBJECT
+
+public:
+	// uses a context of its own
+	ZmqPublisher(QObject *parent = 0);
+
+	// context must outlive the publisher
+	ZmqPublisher(void *context, QObject *parent = 0);
+
+	~ZmqPublisher();
+
+	void setHwm(int hwm);
+
+	bool bind(const QString &spec);
+
+	// the buffer is shared with libzmq until it has been sent
+	void write(const QByteArray &buf);
+
+private:
+	class Private;
+	friend class Private;
+	Private *d;
+};
+
+#endif
@@ -18,8 +18,12 @@ use_curl {
 }
 
 HEADERS += \
+	$$SRC_DIR/batchvalve.h \
+	$$SRC_DIR/engine.h \
 	$$SRC_DIR/app.h
 
 SOURCES += \
+	$$SRC_DIR/batchvalve.cpp \
+	$$SRC_DIR/engine.cpp \
 	$$SRC_DIR/app.cpp \
 	$$SRC_DIR/main.cpp
@@ -0,0 +1,219 @@
+/*
+ * Copyright (C) 2026 Fanout, Inc.
+ *
+ * This file is part of Zurl.
+ *
+ * $FANOUT_BEGIN_LICENSE:GPL$
+ *
+ * Zurl is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zurl is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Zurl may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#include <QtTest/QtTest>
+#include <QHostAddress>
+#include "accesspolicy.h"
+
+// rule matching as done before rules were compiled, for comparison
+
+static bool matchExp(const QString &exp, const QString &s)
+{
+	QHostAddress addr(s);
+
+	if(!addr.isNull())
+	{
+		int at = exp.indexOf('/');
+		if(at != -1)
+		{
+			QPair<QHostAddress, int> sn = QHostAddress::parseSubnet(exp);
+			if(!sn.first.isNull())
+				return addr.isInSubnet(sn.first, sn.second);
+		}
+	}
+
+	int at = exp.indexOf('*');
+	if(at != -1)
+	{
+		QString start = exp.mid(0, at);
+		QString end = exp.mid(at + 1);
+		return (s.startsWith(start, Qt::CaseInsensitive) && s.endsWith(end, Qt::CaseInsensitive));
+	}
+
+	return (s.compare(exp, Qt::CaseInsensitive) == 0);
+}
+
+static bool matchAny(const QStringList &exps, const QString &s)
+{
+	foreach(const QString &exp, exps)
+	{
+		if(matchExp(exp, s))
+			return true;
+	}
+
+	return false;
+}
+
+static bool referenceAllowed(bool defaultAllow, const QStringList &allowExps, const QStringList &denyExps, const QString &in)
+{
+	if(defaultAllow)
+		return !matchAny(denyExps, in) || matchAny(allowExps, in);
+	else
+		return matchAny(allowExps, in) && !matchAny(denyExps, in);
+}
+
+// deterministic rules of every kind
+static QStringList makeRules(int count)
+{
+	QStringList out;
+	for(int n = 0; n < count; ++n)
+	{
+		switch(n % 6)
+		{
+			case 0: out += QString("10.%1.%2.0/24").arg((n / 6) % 256).arg((n / 1536) % 256); break;
+			case 1: out += QString("192.168.%1.%2/32").arg((n / 6) % 256).arg(n % 256); break;
+			case 2: out += QString("fd00:%1::/48").arg(n, 0, 16); break;
+			case 3: out += QString("*.customer%1.example.com").arg(n); break;
+			case 4: out += QString("host%1.Example.NET").arg(n); break;
+			case 5: out += QString("prefix%1-*").arg(n); break;
+		}
+	}
+	return out;
+}
+
+static QStringList makeInputs(int count)
+{
+	QStringList out;
+	for(int n = 0; n < count; ++n)
+	{
+		switch(n % 7)
+		{
+			case 0: out += QString("10.%1.%2.%3").arg(n % 256).arg((n / 7) % 256).arg(n % 200); break;
+			case 1: out += QString("192.168.%1.%2").arg(n % 256).arg((n * 3) % 256); break;
+			case 2: out += QString("fd00:%1::1").arg(n * 6 + 2, 0, 16); break;
+			case 3: out += QString("api.customer%1.EXAMPLE.com").arg(n * 6 + 3); break;
+			case 4: out += QString("HOST%1.example.net").arg(n); break;
+			case 5: out += QString("prefix%1-thing").arg(n); break;
+			case 6: out += QString("unrelated%1.org").arg(n); break;
+		}
+	}
+	return out;
+}
+
+class AccessPolicyTest : public QObject
+{
+	Q_OBJECT
+
+private slots:
+	void rules()
+	{
+		AccessPolicy p;
+		p.setRules(true, QStringList() << "10.1.2.3" << "*.good.example.com",
+			QStringList() << "10.0.0.0/8" << "169.254.169.254" << "fe80::/10" << "*.example.com" << "internal*" << "a*z" << "Metadata");
+
+		QVERIFY(p.isAllowed("8.8.8.8"));
+		QVERIFY(!p.isAllowed("10.9.9.9"));
+		QVERIFY(p.isAllowed("10.1.2.3"));
+		QVERIFY(!p.isAllowed(QHostAddress("10.9.9.9")));
+		QVERIFY(p.isAllowed(QHostAddress("10.1.2.3")));
+		QVERIFY(!p.isAllowed("169.254.169.254"));
+		QVERIFY(!p.isAllowed(QHostAddress("fe80::1")));
+		QVERIFY(p.isAllowed(QHostAddress("fec0::1")));
+		QVERIFY(!p.isAllowed("www.EXAMPLE.com"));
+		QVERIFY(p.isAllowed("api.good.example.com"));
+		QVERIFY(!p.isAllowed("internal-service"));
+		QVERIFY(!p.isAllowed("abcz"));
+		QVERIFY(p.isAllowed("abc"));
+		QVERIFY(!p.isAllowed("metadata"));
+
+		p.setRules(false, QStringList() << "*", QStringList() << "10.0.0.0/8");
+		QVERIFY(p.isAllowed("example.com"));
+		QVERIFY(!p.isAllowed("10.0.0.1"));
+
+		p.setRules(false, QStringList(), QStringList());
+		QVERIFY(!p.isAllowed("example.com"));
+		QVERIFY(!p.isAllowed(QHostAddress("127.0.0.1")));
+	}
+
+	void matchesReference()
+	{
+		QStringList allow = makeRules(600).mid(300);
+		QStringList deny = makeRules(300);
+
+		for(int d = 0; d < 2; ++d)
+		{
+			bool defaultAllow = (d == 0);
+
+			AccessPolicy p;
+			p.setRules(defaultAllow, allow, deny);
+
+			foreach(const QString &in, makeInputs(2000))
+			{
+				bool expected = referenceAllowed(defaultAllow, allow, deny, in);
+				if(p.isAllowed(in) != expected)
+					QFAIL(qPrintable(QString("mismatch for %1").arg(in)));
+
+				QHostAddress addr(in);
+				if(!addr.isNull())
+					QCOMPARE(p.isAllowed(addr), expected);
+			}
+		}
+	}
+
+	void benchmarkLookup()
+	{
+		QStringList deny = makeRules(10000);
+		QStringList inputs = makeInputs(1000);
+
+		AccessPolicy p;
+		p.setRules(true, QStringList(), deny);
+
+		int allowed = 0;
+		QBENCHMARK {
+			allowed = 0;
+			foreach(const QString &in, inputs)
+			{
+				if(p.isAllowed(in))
+					++allowed;
+			}
+		}
+
+		QVERIFY(allowed > 0 && allowed < inputs.count());
+	}
+
+	void benchmarkLookupReference()
+	{
+		QStringList deny = makeRules(10000);
+		QStringList inputs = makeInputs(1000).mid(0, 50);
+
+		int allowed = 0;
+		QBENCHMARK {
+			allowed = 0;
+			foreach(const QString &in, inputs)
+			{
+				if(referenceAllowed(true, QStringList(), deny, in))
+					++allowed;
+			}
+		}
+
+		QVERIFY(allowed > 0);
+	}
+};
+
+QTEST_MAIN(AccessPolicyTest)
+#include "accesspolicytest.moc"
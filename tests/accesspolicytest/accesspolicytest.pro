@@ -0,0 +1,2 @@
+include(../tests.pri)
+SOURCES += accesspolicytest.cpp
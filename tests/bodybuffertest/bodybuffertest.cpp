@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2026 Fanout, Inc.
+ *
+ * This file is part of Zurl.
+ *
+ * $FANOUT_BEGIN_LICENSE:GPL$
+ *
+ * Zurl is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zurl is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Zurl may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#include <QtTest/QtTest>
+#include "bodybuffer.h"
+
+static QByteArray readAll(BodyBuffer *buf, int step)
+{
+	QByteArray out;
+	char tmp[1024];
+	while(true)
+	{
+		int n = buf->read(tmp, step);
+		if(n == 0)
+			break;
+		out += QByteArray(tmp, n);
+	}
+	return out;
+}
+
+class BodyBufferTest : public QObject
+{
+	Q_OBJECT
+
+private slots:
+	void readAcrossSegments()
+	{
+		BodyBuffer buf;
+		buf.append("hello ");
+		buf.append("wor");
+		buf.append("ld");
+		QCOMPARE(buf.size(), 11);
+		QCOMPARE(readAll(&buf, 4), QByteArray("hello world"));
+		QCOMPARE(buf.bytesAvailable(), 0);
+	}
+
+	void seek()
+	{
+		BodyBuffer buf;
+		buf.append("hello ");
+		buf.append("world");
+		QCOMPARE(readAll(&buf, 100), QByteArray("hello world"));
+
+		QVERIFY(buf.seek(0));
+		QCOMPARE(readAll(&buf, 3), QByteArray("hello world"));
+
+		QVERIFY(buf.seek(6));
+		QCOMPARE(readAll(&buf, 100), QByteArray("world"));
+
+		QVERIFY(buf.seek(11));
+		QCOMPARE(buf.bytesAvailable(), 0);
+		QVERIFY(!buf.seek(12));
+	}
+
+	void unretained()
+	{
+		BodyBuffer buf;
+		buf.append("hello ");
+		buf.append("world");
+
+		char tmp[8];
+		QCOMPARE(buf.read(tmp, 8), 8);
+		buf.setRetaining(false);
+		QVERIFY(!buf.seek(0));
+
+		// the partly read segment is still held
+		QCOMPARE(buf.size(), 5);
+		QCOMPARE(buf.bytesAvailable(), 3);
+
+		buf.append("!");
+		QCOMPARE(readAll(&buf, 100), QByteArray("rld!"));
+		QCOMPARE(buf.size(), 0);
+	}
+};
+
+QTEST_MAIN(BodyBufferTest)
+#include "bodybuffertest.moc"
@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) 2026 Fanout, Inc.
+ *
+ * This file is part of Zurl.
+ *
+ * $FANOUT_BEGIN_LICENSE:GPL$
+ *
+ * Zurl is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zurl is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Zurl may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#include <QtTest/QtTest>
+#include "bufferlist.h"
+#include "chunkbuffer.h"
+
+static QByteArray pattern(int size, int start = 0)
+{
+	QByteArray out(size, Qt::Uninitialized);
+	for(int n = 0; n < size; ++n)
+		out[n] = (char)('a' + (start + n) % 26);
+	return out;
+}
+
+class ChunkBufferTest : public QObject
+{
+	Q_OBJECT
+
+private slots:
+	void appendTake()
+	{
+		ChunkBuffer buf;
+		QByteArray data = pattern(100000);
+		for(int n = 0; n < data.size(); n += 1000)
+			buf.append(data.constData() + n, 1000);
+		QCOMPARE(buf.size(), 100000);
+
+		QByteArray out;
+		out += buf.take(10);
+		while(!buf.isEmpty())
+			out += buf.take(7000);
+
+		QCOMPARE(out, data);
+		QVERIFY(buf.take().isEmpty());
+	}
+
+	void handoff()
+	{
+		ChunkBuffer buf;
+		QByteArray data = pattern(ChunkBuffer::ChunkSize * 2 + 10);
+		buf.append(data.constData(), data.size());
+
+		// whole chunks come out one at a time
+		QByteArray a = buf.take();
+		QCOMPARE(a.size(), (int)ChunkBuffer::ChunkSize);
+		QCOMPARE(a, data.mid(0, ChunkBuffer::ChunkSize));
+
+		// appending after a handoff doesn't touch the handed off chunk
+		QByteArray b = buf.take(ChunkBuffer::ChunkSize);
+		buf.append("xyz", 3);
+		QCOMPARE(b, data.mid(ChunkBuffer::ChunkSize, ChunkBuffer::ChunkSize));
+
+		// the small remainder is copied
+		QCOMPARE(buf.take(), data.mid(ChunkBuffer::ChunkSize * 2) + "xyz");
+	}
+
+	void capacity()
+	{
+		ChunkBuffer buf;
+		QCOMPARE(buf.capacityAfter(1), (int)ChunkBuffer::ChunkSize);
+
+		buf.append("abc", 3);
+		QCOMPARE(buf.capacity(), (int)ChunkBuffer::ChunkSize);
+		QCOMPARE(buf.capacityAfter(ChunkBuffer::ChunkSize - 3), (int)ChunkBuffer::ChunkSize);
+		QCOMPARE(buf.capacityAfter(ChunkBuffer::ChunkSize - 2), (int)ChunkBuffer::ChunkSize * 2);
+
+		// read bytes of the first chunk still take memory
+		buf.take(2);
+		QCOMPARE(buf.size(), 1);
+		QCOMPARE(buf.capacityAfter(ChunkBuffer::ChunkSize), (int)ChunkBuffer::ChunkSize * 2);
+	}
+
+	void lentChunksCharged()
+	{
+		// lent chunks are checked for release in batches of this many
+		const int scanMin = 64;
+
+		ChunkBuffer buf;
+		QByteArray data = pattern(ChunkBuffer::ChunkSize * (scanMin + 1));
+		buf.append(data.constData(), data.size());
+		qint64 base = ChunkBuffer::memoryReserved();
+
+		// handed off chunks are charged while referenced
+		QList<QByteArray> lent;
+		for(int n = 0; n < scanMin; ++n)
+			lent += buf.take();
+		QCOMPARE(ChunkBuffer::memoryReserved(), base + ChunkBuffer::ChunkSize * scanMin);
+
+		// with no budget room the pool refuses them, so once released
+		//   they are freed at the next check, which happens on the next
+		//   handoff
+		ChunkBuffer::setMemoryBudget(1);
+		lent.clear();
+		QByteArray last = buf.take();
+		QCOMPARE(ChunkBuffer::memoryReserved(), base + ChunkBuffer::ChunkSize);
+		ChunkBuffer::setMemoryBudget(0);
+	}
+
+	void benchmarkBufferList()
+	{
+		QByteArray data = pattern(16384);
+		QBENCHMARK {
+			BufferList buf;
+			for(int n = 0; n < 64; ++n)
+				buf += QByteArray(data.constData(), data.size());
+			while(!buf.isEmpty())
+				buf.take(50000);
+		}
+	}
+
+	void benchmarkChunkBuffer()
+	{
+		QByteArray data = pattern(16384);
+		QBENCHMARK {
+			ChunkBuffer buf;
+			for(int n = 0; n < 64; ++n)
+				buf.append(data.constData(), data.size());
+			while(!buf.isEmpty())
+				buf.take(50000);
+		}
+	}
+};
+
+QTEST_MAIN(ChunkBufferTest)
+#include "chunkbuffertest.moc"
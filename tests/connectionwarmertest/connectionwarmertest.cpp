@@ -0,0 +1,170 @@
+/*
+ * Copyright (C) 2026 Fanout, Inc.
+ *
+ * This file is part of Zurl.
+ *
+ * $FANOUT_BEGIN_LICENSE:GPL$
+ *
+ * Zurl is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zurl is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Zurl may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#include <QTcpSocket>
+#include <QTcpServer>
+#include <QtTest/QtTest>
+#include "log.h"
+#include "httpheaders.h"
+#include "httprequest.h"
+#include "stats.h"
+#include "connectionwarmer.h"
+
+// answers any number of requests per connection, and counts connections
+class KeepAliveServer : public QObject
+{
+	Q_OBJECT
+
+public:
+	QTcpServer *server;
+	QHash<QTcpSocket*, QByteArray> bufs;
+	int connections;
+	QList<QByteArray> methods;
+
+	KeepAliveServer(QObject *parent = 0) :
+		QObject(parent),
+		server(0),
+		connections(0)
+	{
+	}
+
+	bool listen()
+	{
+		server = new QTcpServer(this);
+		connect(server, &QTcpServer::newConnection, this, &KeepAliveServer::server_newConnection);
+		return server->listen(QHostAddress::LocalHost, 0);
+	}
+
+	QUrl uri() const
+	{
+		return QUrl(QString("http://127.0.0.1:%1/").arg(server->serverPort()));
+	}
+
+private slots:
+	void server_newConnection()
+	{
+		while(server->hasPendingConnections())
+		{
+			QTcpSocket *sock = server->nextPendingConnection();
+			connect(sock, &QTcpSocket::readyRead, this, &KeepAliveServer::sock_readyRead);
+			++connections;
+		}
+	}
+
+	void sock_readyRead()
+	{
+		QTcpSocket *sock = (QTcpSocket *)sender();
+		QByteArray &buf = bufs[sock];
+		buf += sock->readAll();
+
+		int at;
+		while((at = buf.indexOf("\r\n\r\n")) != -1)
+		{
+			QByteArray method = buf.left(buf.indexOf(' '));
+			buf = buf.mid(at + 4);
+			methods += method;
+
+			sock->write("HTTP/1.1 200 OK\r\nContent-Length: 6\r\n\r\n");
+			if(method != "HEAD")
+				sock->write("hello\n");
+		}
+	}
+};
+
+static qint64 statsCounter(const char *name)
+{
+	return Stats::snapshot().toHash()["counters"].toHash()[name].toLongLong();
+}
+
+class ConnectionWarmerTest : public QObject
+{
+	Q_OBJECT
+
+private slots:
+	void initTestCase()
+	{
+		log_setOutputLevel(LOG_LEVEL_INFO);
+	}
+
+	void connectionsReused()
+	{
+		KeepAliveServer server;
+		QVERIFY(server.listen());
+
+		qint64 opened = statsCounter("connections-opened");
+		qint64 reused = statsCounter("connections-reused");
+
+		ConnectionWarmer warmer;
+		QSignalSpy spy(&warmer, SIGNAL(finished()));
+		warmer.start(QList<QUrl>() << server.uri(), 2);
+		QTRY_COMPARE_WITH_TIMEOUT(spy.count(), 1, 10000);
+
+		QCOMPARE(server.connections, 2);
+		QCOMPARE(server.methods, QList<QByteArray>() << "HEAD" << "HEAD");
+		QCOMPARE(statsCounter("connections-opened") - opened, (qint64)2);
+
+		// as many requests at once as there are idle connections
+		QList<HttpRequest*> reqs;
+		for(int n = 0; n < 2; ++n)
+		{
+			HttpRequest *req = new HttpRequest;
+			req->start("GET", server.uri(), HttpHeaders(), false);
+			reqs += req;
+		}
+
+		foreach(HttpRequest *req, reqs)
+		{
+			QTRY_VERIFY_WITH_TIMEOUT(req->isFinished(), 10000);
+			QCOMPARE(req->errorCondition(), HttpRequest::ErrorNone);
+			QCOMPARE(req->readResponseBody(), QByteArray("hello\n"));
+		}
+
+		qDeleteAll(reqs);
+
+		QCOMPARE(server.connections, 2);
+		QCOMPARE(statsCounter("connections-opened") - opened, (qint64)2);
+		QCOMPARE(statsCounter("connections-reused") - reused, (qint64)2);
+	}
+
+	void hostInProgressSkipped()
+	{
+		KeepAliveServer server;
+		QVERIFY(server.listen());
+
+		ConnectionWarmer warmer;
+		QSignalSpy spy(&warmer, SIGNAL(finished()));
+		warmer.start(QList<QUrl>() << server.uri(), 1);
+		warmer.start(QList<QUrl>() << server.uri(), 1);
+		QTRY_COMPARE_WITH_TIMEOUT(spy.count(), 1, 10000);
+
+		QCOMPARE(server.methods.count(), 1);
+	}
+};
+
+QTEST_MAIN(ConnectionWarmerTest)
+#include "connectionwarmertest.moc"
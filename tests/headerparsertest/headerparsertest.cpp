@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2026 Fanout, Inc.
+ *
+ * This file is part of Zurl.
+ *
+ * $FANOUT_BEGIN_LICENSE:GPL$
+ *
+ * Zurl is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zurl is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Zurl may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#include <QtTest/QtTest>
+#include "headerparser.h"
+
+static QList<QByteArray> manyHeaders()
+{
+	QList<QByteArray> lines;
+	lines += "Date: Fri, 16 Oct 2026 12:00:00 GMT";
+	lines += "Content-Type: application/json; charset=utf-8";
+	lines += "Content-Length: 1234";
+	lines += "Connection: keep-alive";
+	lines += "Server: nginx";
+	lines += "Cache-Control: private, max-age=0, no-cache";
+	lines += "Vary: Accept-Encoding";
+	lines += "ETag: \"5f8a1b2c3d4e\"";
+	lines += "Strict-Transport-Security: max-age=31536000; includeSubDomains";
+	lines += "X-Content-Type-Options: nosniff";
+	lines += "X-Frame-Options: DENY";
+	lines += "X-Request-Id: 0b9c3f52-1c2d-4e5f-8a9b-0c1d2e3f4a5b";
+	for(int n = 0; n < 10; ++n)
+		lines += "Set-Cookie: c" + QByteArray::number(n) + "=abcdefghijklmnop; Path=/; Secure; HttpOnly";
+	for(int n = 0; n < 20; ++n)
+		lines += "X-Custom-Header-" + QByteArray::number(n) + ": value " + QByteArray::number(n);
+	return lines;
+}
+
+class HeaderParserTest : public QObject
+{
+	Q_OBJECT
+
+private slots:
+	void parse()
+	{
+		HeaderParser p;
+		QVERIFY(p.addLine("Content-Type: text/plain", 24));
+		QVERIFY(p.addLine("x-empty:", 8));
+		QVERIFY(p.addLine("X-Tight:value", 13));
+		QVERIFY(!p.addLine("no colon", 8));
+		QVERIFY(!p.addLine(": no name", 9));
+		QCOMPARE(p.count(), 3);
+
+		QVERIFY(p.contains("content-type"));
+		QVERIFY(!p.contains("Content-Length"));
+		QCOMPARE(p.value("CONTENT-TYPE"), QByteArray("text/plain"));
+		QCOMPARE(p.value("X-Tight"), QByteArray("value"));
+
+		HttpHeaders h = p.toHeaders();
+		QCOMPARE(h.count(), 3);
+		QCOMPARE(h[0].first, QByteArray("Content-Type"));
+		QCOMPARE(h[1].first, QByteArray("x-empty"));
+		QCOMPARE(h[1].second, QByteArray());
+		QCOMPARE(h[2].second, QByteArray("value"));
+
+		p.clear();
+		QCOMPARE(p.count(), 0);
+		QVERIFY(p.addLine("Date: today", 11));
+		QCOMPARE(p.toHeaders().get("Date"), QByteArray("today"));
+	}
+
+	void intern()
+	{
+		QByteArray a = HeaderParser::internName("Content-Type", 12);
+		QByteArray b = HeaderParser::internName("Content-Type", 12);
+		QCOMPARE(a.constData(), b.constData());
+
+		QByteArray c = HeaderParser::internName("content-type", 12);
+		QCOMPARE(c, QByteArray("content-type"));
+
+		QByteArray d = HeaderParser::internName("X-Unusual", 9);
+		QCOMPARE(d, QByteArray("X-Unusual"));
+	}
+
+	void benchmarkParse()
+	{
+		QList<QByteArray> lines = manyHeaders();
+		QVERIFY(lines.count() >= 40);
+
+		HeaderParser p;
+		HttpHeaders h;
+
+		QBENCHMARK {
+			p.clear();
+			foreach(const QByteArray &line, lines)
+				p.addLine(line.constData(), line.size());
+			h = p.toHeaders();
+		}
+
+		QCOMPARE(h.count(), lines.count());
+	}
+
+	// the previous approach, for comparison
+	void benchmarkParseSplit()
+	{
+		QList<QByteArray> lines = manyHeaders();
+
+		HttpHeaders h;
+
+		QBENCHMARK {
+			h.clear();
+			foreach(const QByteArray &l, lines)
+			{
+				QByteArray line(l.constData(), l.size());
+				int at = line.indexOf(": ");
+				h += HttpHeader(line.mid(0, at), line.mid(at + 2));
+			}
+		}
+
+		QCOMPARE(h.count(), lines.count());
+	}
+};
+
+QTEST_MAIN(HeaderParserTest)
+#include "headerparsertest.moc"
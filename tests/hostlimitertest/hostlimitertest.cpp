@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2026 Fanout, Inc.
+ *
+ * This file is part of Zurl.
+ *
+ * $FANOUT_BEGIN_LICENSE:GPL$
+ *
+ * Zurl is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zurl is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Zurl may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#include <QtTest/QtTest>
+#include "hostlimiter.h"
+
+class HostLimiterTest : public QObject
+{
+	Q_OBJECT
+
+private slots:
+	void queueAndPromote()
+	{
+		HostLimiter limiter(2, 1);
+		QObject a, b, c, d, e;
+		QList<QObject*> acquired;
+
+		QCOMPARE(limiter.acquire("one:80", &a, [&]() { acquired += &a; }), HostLimiter::Acquired);
+		QCOMPARE(limiter.acquire("one:80", &b, [&]() { acquired += &b; }), HostLimiter::Acquired);
+		QCOMPARE(limiter.acquire("one:80", &c, [&]() { acquired += &c; }), HostLimiter::Queued);
+		QCOMPARE(limiter.acquire("one:80", &d, [&]() { acquired += &d; }), HostLimiter::Rejected);
+
+		// other hosts are unaffected
+		QCOMPARE(limiter.acquire("two:80", &e, [&]() { acquired += &e; }), HostLimiter::Acquired);
+
+		// promotion is reported from the event loop
+		limiter.release("one:80", &a);
+		QVERIFY(acquired.isEmpty());
+		QCoreApplication::processEvents();
+		QCOMPARE(acquired, QList<QObject*>() << &c);
+
+		limiter.release("one:80", &b);
+		limiter.release("one:80", &c);
+		limiter.release("two:80", &e);
+	}
+
+	void releaseWhileQueued()
+	{
+		HostLimiter limiter(1, 0);
+		QObject a, b, c;
+		QList<QObject*> acquired;
+
+		QCOMPARE(limiter.acquire("one:80", &a, [&]() { acquired += &a; }), HostLimiter::Acquired);
+		QCOMPARE(limiter.acquire("one:80", &b, [&]() { acquired += &b; }), HostLimiter::Queued);
+		QCOMPARE(limiter.acquire("one:80", &c, [&]() { acquired += &c; }), HostLimiter::Queued);
+
+		// a waiter that gives up is skipped
+		limiter.release("one:80", &b);
+		limiter.release("one:80", &a);
+		QCoreApplication::processEvents();
+		QCOMPARE(acquired, QList<QObject*>() << &c);
+
+		limiter.release("one:80", &c);
+	}
+};
+
+QTEST_MAIN(HostLimiterTest)
+#include "hostlimitertest.moc"
@@ -0,0 +1,324 @@
+/*
+ * Copyright (C) 2026 Fanout, Inc.
+ *
+ * This file is part of Zurl.
+ *
+ * $FANOUT_BEGIN_LICENSE:GPL$
+ *
+ * Zurl is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zurl is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Zurl may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#include <QTcpSocket>
+#include <QTcpServer>
+#include <QtTest/QtTest>
+#include <curl/curl.h>
+#include "log.h"
+#include "httpheaders.h"
+#include "httprequest.h"
+
+#define H2_PREFACE "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n"
+
+// just enough of a cleartext http/2 server to answer GET requests with a
+//   fixed body. request headers are not decoded. clients that don't send
+//   the http/2 preface get http/1.1 with keep-alive instead
+
+class H2Server : public QObject
+{
+	Q_OBJECT
+
+public:
+	enum FrameType
+	{
+		Data = 0x0,
+		Headers = 0x1,
+		Settings = 0x4,
+		Ping = 0x6
+	};
+
+	class Connection
+	{
+	public:
+		QByteArray buf;
+		bool started;
+		bool h2;
+
+		Connection() :
+			started(false),
+			h2(false)
+		{
+		}
+	};
+
+	QTcpServer *server;
+	QHash<QTcpSocket*, Connection*> conns;
+	int connectionCount;
+	int requestCount;
+
+	H2Server(QObject *parent = 0) :
+		QObject(parent),
+		server(0),
+		connectionCount(0),
+		requestCount(0)
+	{
+	}
+
+	~H2Server()
+	{
+		qDeleteAll(conns);
+	}
+
+	bool listen()
+	{
+		server = new QTcpServer(this);
+		connect(server, &QTcpServer::newConnection, this, &H2Server::server_newConnection);
+		return server->listen(QHostAddress::LocalHost, 0);
+	}
+
+	int localPort() const
+	{
+		return server->serverPort();
+	}
+
+	void reset()
+	{
+		connectionCount = 0;
+		requestCount = 0;
+	}
+
+private:
+	static void writeFrame(QTcpSocket *sock, int type, int flags, quint32 streamId, const QByteArray &payload = QByteArray())
+	{
+		QByteArray header(9, 0);
+		header[0] = (char)((payload.size() >> 16) & 0xff);
+		header[1] = (char)((payload.size() >> 8) & 0xff);
+		header[2] = (char)(payload.size() & 0xff);
+		header[3] = (char)type;
+		header[4] = (char)flags;
+		header[5] = (char)((streamId >> 24) & 0x7f);
+		header[6] = (char)((streamId >> 16) & 0xff);
+		header[7] = (char)((streamId >> 8) & 0xff);
+		header[8] = (char)(streamId & 0xff);
+		sock->write(header + payload);
+	}
+
+	void respond(QTcpSocket *sock, quint32 streamId)
+	{
+		++requestCount;
+
+		// hpack static table entry 8 is ":status: 200"
+		writeFrame(sock, Headers, 0x4, streamId, QByteArray(1, (char)0x88));
+		writeFrame(sock, Data, 0x1, streamId, "hello world\n");
+	}
+
+	void processH2(QTcpSocket *sock, Connection *c)
+	{
+		while(c->buf.size() >= 9)
+		{
+			const quint8 *p = (const quint8 *)c->buf.constData();
+			int len = (p[0] << 16) | (p[1] << 8) | p[2];
+			if(c->buf.size() < 9 + len)
+				break;
+
+			int type = p[3];
+			int flags = p[4];
+			quint32 streamId = ((p[5] & 0x7f) << 24) | (p[6] << 16) | (p[7] << 8) | p[8];
+			QByteArray payload = c->buf.mid(9, len);
+			c->buf = c->buf.mid(9 + len);
+
+			if(type == Settings && !(flags & 0x1))
+				writeFrame(sock, Settings, 0x1, 0);
+			else if(type == Ping && !(flags & 0x1))
+				writeFrame(sock, Ping, 0x1, 0, payload);
+			else if((type == Headers || type == Data) && (flags & 0x1))
+				respond(sock, streamId);
+		}
+	}
+
+	void processH1(QTcpSocket *sock, Connection *c)
+	{
+		int at;
+		while((at = c->buf.indexOf("\r\n\r\n")) != -1)
+		{
+			c->buf = c->buf.mid(at + 4);
+			++requestCount;
+			sock->write("HTTP/1.1 200 OK\r\nContent-Length: 12\r\n\r\nhello world\n");
+		}
+	}
+
+private slots:
+	void server_newConnection()
+	{
+		while(server->hasPendingConnections())
+		{
+			QTcpSocket *sock = server->nextPendingConnection();
+			connect(sock, &QTcpSocket::readyRead, this, &H2Server::sock_readyRead);
+			connect(sock, &QTcpSocket::disconnected, this, &H2Server::sock_disconnected);
+			conns.insert(sock, new Connection);
+			++connectionCount;
+		}
+	}
+
+	void sock_readyRead()
+	{
+		QTcpSocket *sock = (QTcpSocket *)sender();
+		Connection *c = conns.value(sock);
+		if(!c)
+			return;
+
+		c->buf += sock->readAll();
+
+		if(!c->started)
+		{
+			int prefaceSize = (int)strlen(H2_PREFACE);
+			if(c->buf.size() < prefaceSize && QByteArray(H2_PREFACE).startsWith(c->buf))
+				return;
+
+			c->started = true;
+			if(c->buf.startsWith(H2_PREFACE))
+			{
+				c->h2 = true;
+				c->buf = c->buf.mid(prefaceSize);
+
+				// advertise a generous stream limit
+				QByteArray settings(6, 0);
+				settings[1] = 0x3; // SETTINGS_MAX_CONCURRENT_STREAMS
+				settings[4] = (char)0x03;
+				settings[5] = (char)0xe8; // 1000
+				writeFrame(sock, Settings, 0, 0, settings);
+			}
+		}
+
+		if(c->h2)
+			processH2(sock, c);
+		else
+			processH1(sock, c);
+	}
+
+	void sock_disconnected()
+	{
+		QTcpSocket *sock = (QTcpSocket *)sender();
+		delete conns.take(sock);
+		sock->deleteLater();
+	}
+};
+
+class Http2Test : public QObject
+{
+	Q_OBJECT
+
+private:
+	H2Server *server;
+
+	// returns how many requests reused a connection
+	int runConcurrent(int count, HttpRequest::HttpVersion version, bool expectHttp2)
+	{
+		QList<HttpRequest*> reqs;
+		for(int n = 0; n < count; ++n)
+		{
+			HttpRequest *req = new HttpRequest;
+			req->setHttpVersion(version);
+			req->start("GET", QString("http://127.0.0.1:%1/").arg(server->localPort()), HttpHeaders(), false);
+			reqs += req;
+		}
+
+		QList<QByteArray> bodies;
+		for(int n = 0; n < count; ++n)
+			bodies += QByteArray();
+
+		while(true)
+		{
+			bool done = true;
+			for(int n = 0; n < count; ++n)
+			{
+				bodies[n] += reqs[n]->readResponseBody();
+				if(!reqs[n]->isFinished())
+					done = false;
+			}
+
+			if(done)
+				break;
+
+			QTest::qWait(10);
+		}
+
+		int reused = 0;
+		for(int n = 0; n < count; ++n)
+		{
+			HttpRequest *req = reqs[n];
+			bodies[n] += req->readResponseBody();
+
+			if(req->errorCondition() != HttpRequest::ErrorNone || req->responseCode() != 200 || req->responseReason() != "OK" || bodies[n] != "hello world\n")
+				return -1;
+
+			if((req->negotiatedHttpVersion() == HttpRequest::Http2) != expectHttp2)
+				return -1;
+
+			if(req->connectionReused())
+				++reused;
+		}
+
+		qDeleteAll(reqs);
+		return reused;
+	}
+
+private slots:
+	void initTestCase()
+	{
+		log_setOutputLevel(LOG_LEVEL_INFO);
+
+		server = new H2Server(this);
+		QVERIFY(server->listen());
+	}
+
+	void cleanupTestCase()
+	{
+		delete server;
+	}
+
+	void multiplexed()
+	{
+		if(!(curl_version_info(CURLVERSION_NOW)->features & CURL_VERSION_HTTP2))
+			QSKIP("libcurl built without http/2 support");
+
+		server->reset();
+		int reused = runConcurrent(50, HttpRequest::Http2PriorKnowledge, true);
+		QCOMPARE(server->requestCount, 50);
+
+		// all streams share one connection
+		QCOMPARE(server->connectionCount, 1);
+		QCOMPARE(reused, 49);
+	}
+
+	void http1Baseline()
+	{
+		server->reset();
+		int reused = runConcurrent(50, HttpRequest::Http1_1, false);
+		QVERIFY(reused >= 0);
+		QCOMPARE(server->requestCount, 50);
+
+		// concurrent http/1.1 requests each need their own connection
+		qDebug("http/1.1 connections: %d, http/2 connections: 1", server->connectionCount);
+		QVERIFY(server->connectionCount > 1);
+	}
+};
+
+QTEST_MAIN(Http2Test)
+#include "http2test.moc"
@@ -27,12 +27,19 @@
  */
 
 #include <assert.h>
+#include <time.h>
+#include <sys/resource.h>
 #include <QTcpSocket>
 #include <QTcpServer>
 #include <QtTest/QtTest>
 #include "log.h"
 #include "httpheaders.h"
 #include "httprequest.h"
+#include "stats.h"
+
+// "hello world\n", gzipped
+static const char *gzipBody = "\x1f\x8b\x08\x00\x00\x00\x00\x00\x02\x03\xcb\x48\xcd\xc9\xc9\x57\x28\xcf\x2f\xca\x49\xe1\x02\x00\x2d\x3b\x08\xaf\x0c\x00\x00\x00";
+static const int gzipBodySize = 32;
 
 class HttpServer : public QObject
 {
@@ -97,6 +104,11 @@ public:
 		{
 			sock->write("HTTP/1.0 304 Not Modified\r\nContent-Length: 12\r\n\r\n");
 		}
+		else if(uri == "/gzip")
+		{
+			sock->write("HTTP/1.0 200 OK\r\nContent-Encoding: gzip\r\nContent-Length: " + QByteArray::number(gzipBodySize) + "\r\n\r\n");
+			sock->write(QByteArray(gzipBody, gzipBodySize));
+		}
 		else if(uri == "/chunked")
 		{
 			QByteArray body = "hello world\n";
@@ -183,11 +195,178 @@ private slots:
 	}
 };
 
+// serves a body to any number of concurrent clients, writing it in pieces
+//   as the socket drains so memory use stays bounded. connections are
+//   kept alive
+
+class StreamServer : public QObject
+{
+	Q_OBJECT
+
+public:
+	QTcpServer *server;
+	int bodySize;
+	QHash<QTcpSocket*, int> remaining;
+
+	StreamServer(int _bodySize, QObject *parent = 0) :
+		QObject(parent),
+		server(0),
+		bodySize(_bodySize)
+	{
+	}
+
+	bool listen()
+	{
+		server = new QTcpServer(this);
+		server->setMaxPendingConnections(10000);
+		connect(server, &QTcpServer::newConnection, this, &StreamServer::server_newConnection);
+		return server->listen(QHostAddress::LocalHost, 0);
+	}
+
+	int localPort() const
+	{
+		return server->serverPort();
+	}
+
+private:
+	void writeMore(QTcpSocket *sock)
+	{
+		int left = remaining.value(sock);
+		while(left > 0 && sock->bytesToWrite() < 16384)
+		{
+			int size = qMin(left, 16384);
+			sock->write(QByteArray(size, 'x'));
+			left -= size;
+		}
+		remaining[sock] = left;
+	}
+
+private slots:
+	void server_newConnection()
+	{
+		while(server->hasPendingConnections())
+		{
+			QTcpSocket *sock = server->nextPendingConnection();
+			connect(sock, &QTcpSocket::readyRead, this, &StreamServer::sock_readyRead);
+			connect(sock, &QTcpSocket::bytesWritten, this, &StreamServer::sock_bytesWritten);
+			connect(sock, &QTcpSocket::disconnected, this, &StreamServer::sock_disconnected);
+		}
+	}
+
+	void sock_readyRead()
+	{
+		QTcpSocket *sock = (QTcpSocket *)sender();
+		if(remaining.value(sock) > 0)
+		{
+			sock->readAll();
+			return;
+		}
+
+		if(!sock->peek(4096).contains("\r\n\r\n"))
+			return;
+
+		sock->readAll();
+		sock->write("HTTP/1.1 200 OK\r\nContent-Length: " + QByteArray::number(bodySize) + "\r\n\r\n");
+		remaining[sock] = bodySize;
+		writeMore(sock);
+	}
+
+	void sock_bytesWritten(qint64 bytes)
+	{
+		Q_UNUSED(bytes);
+
+		writeMore((QTcpSocket *)sender());
+	}
+
+	void sock_disconnected()
+	{
+		QTcpSocket *sock = (QTcpSocket *)sender();
+		remaining.remove(sock);
+		sock->deleteLater();
+	}
+};
+
+// reads and discards a request body of the given content length, then
+//   responds
+
+class DiscardServer : public QObject
+{
+	Q_OBJECT
+
+public:
+	QTcpServer *server;
+	QTcpSocket *sock;
+	bool headerDone;
+	qint64 remaining;
+
+	DiscardServer(QObject *parent = 0) :
+		QObject(parent),
+		server(0),
+		sock(0),
+		headerDone(false),
+		remaining(0)
+	{
+	}
+
+	bool listen()
+	{
+		server = new QTcpServer(this);
+		connect(server, &QTcpServer::newConnection, this, &DiscardServer::server_newConnection);
+		return server->listen(QHostAddress::LocalHost, 0);
+	}
+
+	int localPort() const
+	{
+		return server->serverPort();
+	}
+
+private slots:
+	void server_newConnection()
+	{
+		sock = server->nextPendingConnection();
+		headerDone = false;
+		connect(sock, &QTcpSocket::readyRead, this, &DiscardServer::sock_readyRead);
+		connect(sock, &QTcpSocket::disconnected, sock, &QObject::deleteLater);
+	}
+
+	void sock_readyRead()
+	{
+		if(!headerDone)
+		{
+			while(sock->canReadLine())
+			{
+				QByteArray line = sock->readLine().trimmed();
+				if(line.isEmpty())
+				{
+					headerDone = true;
+					break;
+				}
+
+				if(line.toLower().startsWith("content-length:"))
+					remaining = line.mid(15).trimmed().toLongLong();
+			}
+
+			if(!headerDone)
+				return;
+		}
+
+		remaining -= sock->readAll().size();
+		if(remaining <= 0)
+			sock->write("HTTP/1.1 200 OK\r\nContent-Length: 0\r\n\r\n");
+	}
+};
+
+static qint64 statsCounter(const char *name)
+{
+	return Stats::snapshot().toHash()["counters"].toHash()[name].toLongLong();
+}
+
 class HttpRequestTest : public QObject
 {
 	Q_OBJECT
 
 private:
+	HttpRequest::EventBackend backend;
 	HttpServer *server;
 
 	void waitForSignal(QSignalSpy *spy)
@@ -196,12 +375,84 @@ private:
 			QTest::qWait(10);
 	}
 
+	// many downloads, each larger than the connection buffer so transfers
+	//   pause, with small credit windows granted to a few requests per
+	//   event loop turn, like credit packets trickling in from clients
+	void streamingDownloads(bool targetedUnpause)
+	{
+		int count = qgetenv("HTTPREQUESTTEST_STREAMS").toInt();
+		if(count <= 0)
+			count = 5000;
+
+		// each download uses a socket on both ends
+		struct rlimit rl;
+		getrlimit(RLIMIT_NOFILE, &rl);
+		rl.rlim_cur = qMin(rl.rlim_max, (rlim_t)(count * 2 + 100));
+		setrlimit(RLIMIT_NOFILE, &rl);
+		if(rl.rlim_cur < (rlim_t)(count * 2 + 100))
+			QSKIP("not enough file descriptors");
+
+		HttpRequest::setTargetedUnpause(targetedUnpause);
+
+		StreamServer streamServer(400000);
+		QVERIFY(streamServer.listen());
+
+		QList<HttpRequest*> reqs;
+		for(int n = 0; n < count; ++n)
+		{
+			HttpRequest *req = new HttpRequest;
+			req->start("GET", QString("http://127.0.0.1:%1/").arg(streamServer.localPort()), HttpHeaders(), false);
+			reqs += req;
+		}
+
+		clock_t cpuStart = clock();
+
+		QBENCHMARK_ONCE {
+			int finished = 0;
+			int next = 0;
+			while(finished < count)
+			{
+				finished = 0;
+				for(int n = 0; n < 50; ++n)
+				{
+					reqs[next]->readResponseBody(8192);
+					next = (next + 1) % count;
+				}
+
+				foreach(HttpRequest *req, reqs)
+				{
+					if(req->isFinished() && req->bytesAvailable() == 0)
+						++finished;
+				}
+
+				QCoreApplication::processEvents();
+			}
+		}
+
+		qDebug("cpu time: %dms", (int)((clock() - cpuStart) * 1000 / CLOCKS_PER_SEC));
+
+		foreach(HttpRequest *req, reqs)
+			QCOMPARE(req->errorCondition(), HttpRequest::ErrorNone);
+
+		qDeleteAll(reqs);
+		HttpRequest::setTargetedUnpause(true);
+	}
+
+public:
+	HttpRequestTest(HttpRequest::EventBackend _backend) :
+		backend(_backend),
+		server(0)
+	{
+	}
+
 private slots:
 	void initTestCase()
 	{
 		log_setOutputLevel(LOG_LEVEL_INFO);
 		//log_setOutputLevel(LOG_LEVEL_DEBUG);
 
+		HttpRequest::setEventBackend(backend);
+
 		server = new HttpServer(this);
 		if(!server->listen()) {
 			QFAIL("HttpServer failed to listen");
@@ -326,6 +577,51 @@ private slots:
 		server->closeAllRequests();
 	}
 
+	void requestGetDecoded()
+	{
+		HttpRequest req;
+		req.start("GET", QString("http://localhost:%1/gzip").arg(server->localPort()), HttpHeaders());
+		req.endBody();
+		QByteArray respBody;
+		while(!req.isFinished())
+		{
+			respBody += req.readResponseBody();
+			QTest::qWait(10);
+		}
+		respBody += req.readResponseBody();
+		HttpHeaders respHeaders = req.responseHeaders();
+
+		QCOMPARE(req.responseCode(), 200);
+		QVERIFY(!respHeaders.contains("content-length"));
+		QCOMPARE(respBody, QByteArray("hello world\n"));
+		server->closeAllRequests();
+	}
+
+	void requestGetPassthrough()
+	{
+		HttpRequest req;
+		req.setDecodeContent(false);
+		HttpHeaders headers;
+		headers += HttpHeader("Accept-Encoding", "gzip");
+		req.start("GET", QString("http://localhost:%1/gzip").arg(server->localPort()), headers);
+		req.endBody();
+		QByteArray respBody;
+		while(!req.isFinished())
+		{
+			respBody += req.readResponseBody();
+			QTest::qWait(10);
+		}
+		respBody += req.readResponseBody();
+		HttpHeaders respHeaders = req.responseHeaders();
+
+		QCOMPARE(server->requestHeaders.get("Accept-Encoding"), QByteArray("gzip"));
+		QCOMPARE(req.responseCode(), 200);
+		QCOMPARE(respHeaders.get("content-encoding"), QByteArray("gzip"));
+		QCOMPARE(respHeaders.get("content-length").toInt(), gzipBodySize);
+		QCOMPARE(respBody, QByteArray(gzipBody, gzipBodySize));
+		server->closeAllRequests();
+	}
+
 	void requestPostBody()
 	{
 		HttpRequest req;
@@ -469,7 +765,183 @@ private slots:
 		QVERIFY(!server->requestHeaders.contains("Content-Length"));
 		QVERIFY(!server->requestHeaders.contains("Transfer-Encoding"));
 		server->closeAllRequests();
-	} };
+	}
+
+	// the reader stops reading mid-body, so the receive buffer fills and
+	//   the transfer is paused, then drains it so the transfer resumes
+	void requestPausedThenUnpaused()
+	{
+		const int total = 1000000;
+		const int maxBuffer = 65536;
+
+		HttpRequest::setMaxBufferSize(maxBuffer);
+
+		StreamServer streamServer(total);
+		QVERIFY(streamServer.listen());
+
+		HttpRequest req;
+		req.start("GET", QString("http://127.0.0.1:%1/").arg(streamServer.localPort()), HttpHeaders(), false);
+
+		// wait for the buffer to stop growing
+		int last = -1;
+		for(int n = 0; n < 100; ++n)
+		{
+			int avail = req.bytesAvailable();
+			if(avail > 0 && avail == last)
+				break;
+			last = avail;
+			QTest::qWait(50);
+		}
+
+		QVERIFY(req.bytesAvailable() > 0);
+		QVERIFY(req.bytesAvailable() < total);
+		QVERIFY(!req.isFinished());
+
+		QByteArray respBody = req.readResponseBody();
+		while(!req.isFinished() && req.errorCondition() == HttpRequest::ErrorNone)
+		{
+			QTest::qWait(10);
+			respBody += req.readResponseBody();
+		}
+		respBody += req.readResponseBody();
+
+		HttpRequest::setMaxBufferSize(200000);
+
+		QCOMPARE(req.errorCondition(), HttpRequest::ErrorNone);
+		QCOMPARE(req.responseCode(), 200);
+		QCOMPARE(respBody.size(), total);
+	}
+
+	void benchmarkUpload()
+	{
+		const qint64 total = 100 * 1024 * 1024;
+		const int window = 1000000;
+
+		DiscardServer discardServer;
+		QVERIFY(discardServer.listen());
+
+		QByteArray piece(65536, 'x');
+
+		HttpRequest req;
+		qint64 written = 0;
+		qint64 acked = 0;
+		connect(&req, &HttpRequest::bytesWritten, [&](int count) { acked += count; });
+
+		HttpHeaders headers;
+		headers += HttpHeader("Content-Length", QByteArray::number(total));
+
+		QElapsedTimer t;
+		t.start();
+
+		QBENCHMARK_ONCE {
+			req.start("POST", QString("http://127.0.0.1:%1/").arg(discardServer.localPort()), headers);
+
+			// keep about a window's worth of body queued, as the worker
+			//   does with credits
+			while(!req.isFinished())
+			{
+				while(written < total && written - acked < window)
+				{
+					int size = (int)qMin((qint64)piece.size(), total - written);
+					req.writeBody(size == piece.size() ? piece : piece.left(size));
+					written += size;
+					if(written == total)
+						req.endBody();
+				}
+
+				QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
+			}
+		}
+
+		QCOMPARE(req.errorCondition(), HttpRequest::ErrorNone);
+		QCOMPARE(req.responseCode(), 200);
+
+		qDebug("upload: %d MB/s", (int)(total * 1000 / qMax(t.elapsed(), (qint64)1) / (1024 * 1024)));
+	}
+
+	// many small requests over kept-alive connections, like webhooks
+	void benchmarkShortRequests()
+	{
+		const int count = 20000;
+		const int concurrency = 100;
+
+		StreamServer shortServer(100);
+		QVERIFY(shortServer.listen());
+		QString uri = QString("http://127.0.0.1:%1/").arg(shortServer.localPort());
+
+		qint64 created = statsCounter("easy-handles-created");
+		qint64 reused = statsCounter("easy-handles-reused");
+
+		QElapsedTimer t;
+		t.start();
+
+		QBENCHMARK_ONCE {
+			QList<HttpRequest*> active;
+			int started = 0;
+			int finished = 0;
+			while(finished < count)
+			{
+				while(started < count && active.count() < concurrency)
+				{
+					HttpRequest *req = new HttpRequest;
+					req->start("GET", uri, HttpHeaders(), false);
+					active += req;
+					++started;
+				}
+
+				QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
+
+				for(int n = 0; n < active.count(); ++n)
+				{
+					HttpRequest *req = active[n];
+					req->readResponseBody();
+					if(req->isFinished() || req->errorCondition() != HttpRequest::ErrorNone)
+					{
+						QCOMPARE(req->errorCondition(), HttpRequest::ErrorNone);
+						active.removeAt(n--);
+						delete req;
+						++finished;
+					}
+				}
+			}
+		}
+
+		created = statsCounter("easy-handles-created") - created;
+		reused = statsCounter("easy-handles-reused") - reused;
+
+		qDebug("short requests: %d/s, easy handle allocations per request: %.3f (reused %lld)",
+			(int)(count * 1000 / qMax(t.elapsed(), (qint64)1)), (double)created / count, reused);
+	}
+
+	void benchmarkStreamingUnpauseAll()
+	{
+		streamingDownloads(false);
+	}
+
+	void benchmarkStreamingTargetedUnpause()
+	{
+		streamingDownloads(true);
+	}
+};
+
+// the whole suite runs once per event backend
+int main(int argc, char **argv)
+{
+	QCoreApplication app(argc, argv);
+
+	int ret;
+	{
+		HttpRequestTest test(HttpRequest::QtEventBackend);
+		ret = QTest::qExec(&test, argc, argv);
+	}
+
+#ifdef Q_OS_LINUX
+	{
+		HttpRequestTest test(HttpRequest::EpollEventBackend);
+		ret |= QTest::qExec(&test, argc, argv);
+	}
+#endif
 
-QTEST_MAIN(HttpRequestTest)
+	return ret;
+}
 #include "httprequesttest.moc"
@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2026 Fanout, Inc.
+ *
+ * This file is part of Zurl.
+ *
+ * $FANOUT_BEGIN_LICENSE:GPL$
+ *
+ * Zurl is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zurl is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Zurl may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#include <QtTest/QtTest>
+#include <QThread>
+#include "stats.h"
+
+static qint64 counter(const char *name)
+{
+	return Stats::snapshot().toHash()["counters"].toHash()[name].toLongLong();
+}
+
+static QVariantHash histogram(const char *name)
+{
+	return Stats::snapshot().toHash()["histograms"].toHash()[name].toHash();
+}
+
+class CountThread : public QThread
+{
+protected:
+	void run()
+	{
+		for(int i = 0; i < 1000; ++i)
+			Stats::add(Stats::RequestsStarted);
+	}
+};
+
+class StatsTest : public QObject
+{
+	Q_OBJECT
+
+private slots:
+	void counters()
+	{
+		qint64 base = counter("bytes-in");
+		Stats::add(Stats::BytesIn, 100);
+		Stats::add(Stats::BytesIn, 23);
+		QCOMPARE(counter("bytes-in"), base + 123);
+
+		base = counter("error-tls-error");
+		qint64 otherBase = counter("error-other");
+		Stats::addError("tls-error");
+		Stats::addError("no-such-condition");
+		QCOMPARE(counter("error-tls-error"), base + 1);
+		QCOMPARE(counter("error-other"), otherBase + 1);
+	}
+
+	void threads()
+	{
+		qint64 base = counter("requests-started");
+
+		QList<QThread*> threads;
+		for(int n = 0; n < 4; ++n)
+		{
+			QThread *t = new CountThread;
+			t->start();
+			threads += t;
+		}
+
+		foreach(QThread *t, threads)
+		{
+			t->wait();
+			delete t;
+		}
+
+		// counts from finished threads are kept
+		QCOMPARE(counter("requests-started"), base + 4000);
+	}
+
+	void percentiles()
+	{
+		for(int n = 1; n <= 1000; ++n)
+			Stats::record(Stats::TotalTime, n * 1000);
+
+		QVariantHash h = histogram("total-time");
+		QCOMPARE(h["count"].toLongLong(), 1000LL);
+		QCOMPARE(h["max"].toLongLong(), 1000000LL);
+
+		// buckets are within about 12% of the true value
+		qint64 p50 = h["p50"].toLongLong();
+		QVERIFY(p50 >= 500000 && p50 <= 570000);
+		qint64 p99 = h["p99"].toLongLong();
+		QVERIFY(p99 >= 990000 && p99 <= 1120000);
+	}
+
+	void benchmarkRecord()
+	{
+		qint64 n = 0;
+		QBENCHMARK {
+			Stats::record(Stats::FirstByteTime, ++n);
+		}
+	}
+};
+
+QTEST_MAIN(StatsTest)
+#include "statstest.moc"
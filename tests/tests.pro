@@ -1,5 +1,17 @@
 TEMPLATE = subdirs
 
 SUBDIRS += \
+	accesspolicytest \
+	bodybuffertest \
+	chunkbuffertest \
+	connectionwarmertest \
+	headerparsertest \
+	hostlimitertest \
+	http2test \
 	httprequesttest \
-	websockettest
+	statstest \
+	timerwheeltest \
+	websockettest \
+	workertest \
+	zhttpcodectest \
+	zmqpublishertest
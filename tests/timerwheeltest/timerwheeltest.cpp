@@ -0,0 +1,228 @@
+/*
+ * Copyright (C) 2026 Fanout, Inc.
+ *
+ * This file is part of Zurl.
+ *
+ * $FANOUT_BEGIN_LICENSE:GPL$
+ *
+ * Zurl is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zurl is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Zurl may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#include <QtTest/QtTest>
+#include "timerwheel.h"
+
+#define SESSIONS 100000
+
+class TimerWheelTest : public QObject
+{
+	Q_OBJECT
+
+private slots:
+	void fire()
+	{
+		TimerWheel wheel;
+		qint64 start = wheel.currentTick();
+
+		QList<int> fired;
+		WheelTimer a(&wheel), b(&wheel), c(&wheel);
+		a.setCallback([&]() { fired += 1; });
+		b.setCallback([&]() { fired += 2; });
+		c.setCallback([&]() { fired += 3; });
+
+		a.start(100);
+		b.start(50);
+		c.start(70);
+		QCOMPARE(wheel.count(), 3);
+
+		c.stop();
+		QVERIFY(!c.isActive());
+		QCOMPARE(wheel.count(), 2);
+
+		wheel.advance(start + 4);
+		QVERIFY(fired.isEmpty());
+
+		wheel.advance(start + 20);
+		QCOMPARE(fired, QList<int>() << 2 << 1);
+		QCOMPARE(wheel.count(), 0);
+		QVERIFY(!a.isActive());
+	}
+
+	void restart()
+	{
+		TimerWheel wheel;
+		qint64 start = wheel.currentTick();
+
+		int fired = 0;
+		WheelTimer t(&wheel);
+		t.setCallback([&]() { ++fired; });
+
+		t.start(100);
+		wheel.advance(start + 5);
+		t.start(100);
+		wheel.advance(start + 12);
+		QCOMPARE(fired, 0);
+
+		wheel.advance(start + 20);
+		QCOMPARE(fired, 1);
+	}
+
+	void cascade()
+	{
+		TimerWheel wheel;
+		qint64 start = wheel.currentTick();
+
+		// far enough out to start in the upper levels
+		int fired = 0;
+		WheelTimer t(&wheel);
+		t.setCallback([&]() { ++fired; });
+		t.start(600 * 1000);
+
+		wheel.advance(start + 59999);
+		QCOMPARE(fired, 0);
+
+		wheel.advance(start + 60000);
+		QCOMPARE(fired, 1);
+	}
+
+	void deleteInCallback()
+	{
+		TimerWheel wheel;
+		qint64 start = wheel.currentTick();
+
+		// whichever fires first deletes both
+		int fired = 0;
+		WheelTimer *a = new WheelTimer(&wheel);
+		WheelTimer *b = new WheelTimer(&wheel);
+		std::function<void ()> callback = [&]() {
+			++fired;
+			delete a;
+			a = 0;
+			delete b;
+			b = 0;
+		};
+		a->setCallback(callback);
+		b->setCallback(callback);
+		a->start(10);
+		b->start(10);
+
+		wheel.advance(start + 1);
+		QCOMPARE(fired, 1);
+		QCOMPARE(wheel.count(), 0);
+	}
+
+	void idle()
+	{
+		TimerWheel wheel;
+		qint64 start = wheel.currentTick();
+
+		int fired = 0;
+		WheelTimer t(&wheel);
+		t.setCallback([&]() { ++fired; });
+
+		// time passes with nothing pending, and without an event loop
+		QTest::qSleep(100);
+
+		// arming catches the wheel up to the clock, so the next advance
+		//   doesn't walk the idle ticks one by one
+		t.start(20);
+		QVERIFY(wheel.currentTick() >= start + 100 / TimerWheel::TickMsecs);
+
+		qint64 armed = wheel.currentTick();
+		wheel.advance(armed + 1);
+		QCOMPARE(fired, 0);
+
+		wheel.advance(armed + 2);
+		QCOMPARE(fired, 1);
+	}
+
+	void eventLoop()
+	{
+		bool fired = false;
+		WheelTimer t;
+		t.setCallback([&]() { fired = true; });
+		t.start(20);
+
+		QTRY_VERIFY(fired);
+	}
+
+	void eventLoopWithFarTimer()
+	{
+		// a far timer doesn't keep nearer ones from firing on time
+		TimerWheel wheel;
+		WheelTimer far(&wheel), near(&wheel);
+		bool nearFired = false;
+		far.setCallback([]() {});
+		near.setCallback([&]() { nearFired = true; });
+		far.start(600 * 1000);
+		near.start(50);
+
+		QTRY_VERIFY(nearFired);
+		QVERIFY(far.isActive());
+
+		// arming an earlier timer re-arms the wheel
+		nearFired = false;
+		near.start(3000);
+		WheelTimer soon(&wheel);
+		bool soonFired = false;
+		soon.setCallback([&]() { soonFired = true; });
+		soon.start(20);
+		QTRY_VERIFY_WITH_TIMEOUT(soonFired, 1000);
+		QVERIFY(!nearFired);
+	}
+
+	// each session re-arms its expire and activity timeouts per packet
+
+	void benchmarkWheelChurn()
+	{
+		TimerWheel wheel;
+		QList<WheelTimer*> timers;
+		for(int n = 0; n < SESSIONS * 2; ++n)
+			timers += new WheelTimer(&wheel);
+
+		QBENCHMARK {
+			foreach(WheelTimer *t, timers)
+				t->start(60000);
+		}
+
+		qDeleteAll(timers);
+	}
+
+	void benchmarkQTimerChurn()
+	{
+		QList<QTimer*> timers;
+		for(int n = 0; n < SESSIONS * 2; ++n)
+		{
+			QTimer *t = new QTimer;
+			t->setSingleShot(true);
+			timers += t;
+		}
+
+		QBENCHMARK {
+			foreach(QTimer *t, timers)
+				t->start(60000);
+		}
+
+		qDeleteAll(timers);
+	}
+};
+
+QTEST_MAIN(TimerWheelTest)
+#include "timerwheeltest.moc"
@@ -26,13 +26,69 @@
  * $FANOUT_END_LICENSE$
  */
 
+#include <string.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <QTcpSocket>
 #include <QTcpServer>
 #include <QtTest/QtTest>
 #include "log.h"
 #include "httpheaders.h"
+#include "addressresolver.h"
 #include "websocket.h"
 
+// a listener that never completes a handshake. its accept queue is filled
+//   and never drained, so further connection attempts get no reply
+class UnresponsiveListener
+{
+public:
+	int fd;
+	QList<int> fillers;
+
+	UnresponsiveListener() :
+		fd(-1)
+	{
+	}
+
+	~UnresponsiveListener()
+	{
+		foreach(int f, fillers)
+			::close(f);
+		if(fd != -1)
+			::close(fd);
+	}
+
+	// returns the port, or -1 on error
+	int listen(const char *addr)
+	{
+		struct sockaddr_in sa;
+		memset(&sa, 0, sizeof(sa));
+		sa.sin_family = AF_INET;
+		sa.sin_port = 0;
+		inet_pton(AF_INET, addr, &sa.sin_addr);
+
+		fd = socket(AF_INET, SOCK_STREAM, 0);
+		if(fd == -1 || bind(fd, (struct sockaddr *)&sa, sizeof(sa)) != 0 || ::listen(fd, 0) != 0)
+			return -1;
+
+		socklen_t len = sizeof(sa);
+		getsockname(fd, (struct sockaddr *)&sa, &len);
+
+		for(int n = 0; n < 2; ++n)
+		{
+			int f = socket(AF_INET, SOCK_STREAM, 0);
+			fcntl(f, F_SETFL, fcntl(f, F_GETFL) | O_NONBLOCK);
+			::connect(f, (struct sockaddr *)&sa, sizeof(sa));
+			fillers += f;
+		}
+
+		return ntohs(sa.sin_port);
+	}
+};
+
 class WebSocketServer : public QObject
 {
 	Q_OBJECT
@@ -50,11 +106,11 @@ public:
 	{
 	}
 
-	bool listen()
+	bool listen(const QHostAddress &addr = QHostAddress::Any, int port = 0)
 	{
 		server = new QTcpServer(this);
 		connect(server, &QTcpServer::newConnection, this, &WebSocketServer::server_newConnection);
-		if(server->listen(QHostAddress::Any, 0))
+		if(server->listen(addr, port))
 			return true;
 
 		delete server;
@@ -163,6 +219,7 @@ private slots:
 	void initTestCase()
 	{
 		log_setOutputLevel(LOG_LEVEL_INFO);
+		qRegisterMetaType<QHostAddress>();
 
 		server = new WebSocketServer(this);
 		server->listen();
@@ -193,6 +250,61 @@ private slots:
 		QCOMPARE(sock.errorCondition(), WebSocket::ErrorConnect);
 	}
 
+	void handshakeIPv6NotAllowed()
+	{
+		// the only address is filtered out, so nothing is attempted
+		WebSocket sock;
+		QSignalSpy addrSpy(&sock, SIGNAL(nextAddress(QHostAddress)));
+		QSignalSpy spy(&sock, SIGNAL(error()));
+		sock.setAllowIPv6(false);
+		sock.start(QString("http://[::1]:%1/").arg(server->localPort()));
+		waitForSignal(&spy);
+
+		QCOMPARE(sock.errorCondition(), WebSocket::ErrorPolicy);
+		QVERIFY(addrSpy.isEmpty());
+	}
+
+	void handshakeRaceUnresponsive()
+	{
+		// 127.0.0.2 is loopback on linux, but needn't be elsewhere
+#ifndef Q_OS_LINUX
+		QSKIP("needs the 127/8 loopback range");
+#endif
+
+		UnresponsiveListener blackhole;
+		int port = blackhole.listen("127.0.0.2");
+		QVERIFY(port != -1);
+
+		// the server that should win, on the same port
+		WebSocketServer winner;
+		if(!winner.listen(QHostAddress("127.0.0.1"), port))
+			QSKIP("port in use on 127.0.0.1");
+
+		QTest::qWait(50); // let the fillers complete their handshakes
+
+		WebSocket sock;
+		QSignalSpy addrSpy(&sock, SIGNAL(nextAddress(QHostAddress)));
+		QSignalSpy spy(&sock, SIGNAL(connected()));
+		QElapsedTimer elapsed;
+		elapsed.start();
+		sock.start(QString("http://127.0.0.1:%1/").arg(port));
+
+		// substitute the addresses before the resolver reports its own
+		AddressResolver *resolver = sock.findChild<AddressResolver*>();
+		QVERIFY(resolver);
+		emit resolver->resultsReady(QList<QHostAddress>() << QHostAddress("127.0.0.2") << QHostAddress("127.0.0.1"));
+		resolver->blockSignals(true);
+
+		waitForSignal(&spy);
+
+		// the second address is only tried after the attempt delay (250ms)
+		QVERIFY(elapsed.elapsed() >= 200);
+		QCOMPARE(addrSpy.count(), 2);
+		QCOMPARE(addrSpy[0][0].value<QHostAddress>(), QHostAddress("127.0.0.2"));
+		QCOMPARE(addrSpy[1][0].value<QHostAddress>(), QHostAddress("127.0.0.1"));
+		QCOMPARE(sock.responseCode(), 101);
+	}
+
 	void handshakeSuccess()
 	{
 		WebSocket sock;
@@ -0,0 +1,448 @@
+/*
+ * Copyright (C) 2026 Fanout, Inc.
+ *
+ * This file is part of Zurl.
+ *
+ * $FANOUT_BEGIN_LICENSE:GPL$
+ *
+ * Zurl is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zurl is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Zurl may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#include <QTcpSocket>
+#include <QTcpServer>
+#include <QtTest/QtTest>
+#include "zhttprequestpacket.h"
+#include "zhttpresponsepacket.h"
+#include "appconfig.h"
+#include "hostlimiter.h"
+#include "stats.h"
+#include "zhttpcodec.h"
+#include "worker.h"
+
+static void initConfig(AppConfig *config)
+{
+	config->defaultPolicy = "allow";
+	config->allowIPv6 = false;
+	config->maxWorkers = 10;
+	config->maxHostRequests = 1;
+	config->maxHostQueue = 1;
+	config->sessionBufferSize = 200000;
+	config->activityTimeout = 60;
+	config->persistentConnectionMaxTime = 0;
+	config->engineThreads = 1;
+	config->coalesceInterval = 0;
+	config->flushSize = 0;
+	config->flushDelay = 20;
+	config->http2 = false;
+}
+
+// sends the response header right away, then the body in pieces, each
+//   after a delay following the previous one
+class TrickleServer : public QObject
+{
+	Q_OBJECT
+
+public:
+	QTcpServer *server;
+	QTcpSocket *sock;
+	QList<QPair<int, int> > pieces; // delay, size
+	int contentLength;
+	int written;
+
+	TrickleServer(QObject *parent = 0) :
+		QObject(parent),
+		server(0),
+		sock(0),
+		written(0)
+	{
+	}
+
+	void addPiece(int delay, int size)
+	{
+		pieces += QPair<int, int>(delay, size);
+	}
+
+	bool listen()
+	{
+		contentLength = 0;
+		for(int n = 0; n < pieces.count(); ++n)
+			contentLength += pieces[n].second;
+
+		server = new QTcpServer(this);
+		connect(server, &QTcpServer::newConnection, this, &TrickleServer::server_newConnection);
+		return server->listen(QHostAddress::LocalHost, 0);
+	}
+
+	QString uri() const
+	{
+		return QString("http://127.0.0.1:%1/").arg(server->serverPort());
+	}
+
+private:
+	void writeNext()
+	{
+		if(pieces.isEmpty())
+			return;
+
+		QTimer::singleShot(pieces.first().first, this, [=]() {
+			int size = pieces.takeFirst().second;
+			sock->write(QByteArray(size, 'x'));
+			written += size;
+			writeNext();
+		});
+	}
+
+private slots:
+	void server_newConnection()
+	{
+		sock = server->nextPendingConnection();
+		connect(sock, &QTcpSocket::readyRead, this, &TrickleServer::sock_readyRead);
+	}
+
+	void sock_readyRead()
+	{
+		if(!sock->peek(4096).contains("\r\n\r\n"))
+			return;
+
+		sock->readAll();
+		sock->write("HTTP/1.1 200 OK\r\nContent-Length: " + QByteArray::number(contentLength) + "\r\n\r\n");
+		writeNext();
+	}
+};
+
+// answers any number of requests per connection, and counts connections
+class KeepAliveServer : public QObject
+{
+	Q_OBJECT
+
+public:
+	QTcpServer *server;
+	QHash<QTcpSocket*, QByteArray> bufs;
+	int connections;
+	QList<QByteArray> methods;
+
+	KeepAliveServer(QObject *parent = 0) :
+		QObject(parent),
+		server(0),
+		connections(0)
+	{
+	}
+
+	bool listen()
+	{
+		server = new QTcpServer(this);
+		connect(server, &QTcpServer::newConnection, this, &KeepAliveServer::server_newConnection);
+		return server->listen(QHostAddress::LocalHost, 0);
+	}
+
+	QString uri() const
+	{
+		return QString("http://127.0.0.1:%1/").arg(server->serverPort());
+	}
+
+private slots:
+	void server_newConnection()
+	{
+		while(server->hasPendingConnections())
+		{
+			QTcpSocket *sock = server->nextPendingConnection();
+			connect(sock, &QTcpSocket::readyRead, this, &KeepAliveServer::sock_readyRead);
+			++connections;
+		}
+	}
+
+	void sock_readyRead()
+	{
+		QTcpSocket *sock = (QTcpSocket *)sender();
+		QByteArray &buf = bufs[sock];
+		buf += sock->readAll();
+
+		int at;
+		while((at = buf.indexOf("\r\n\r\n")) != -1)
+		{
+			QByteArray method = buf.left(buf.indexOf(' '));
+			buf = buf.mid(at + 4);
+			methods += method;
+
+			sock->write("HTTP/1.1 200 OK\r\nContent-Length: 6\r\n\r\n");
+			if(method != "HEAD")
+				sock->write("hello\n");
+		}
+	}
+};
+
+static qint64 statsCounter(const char *name)
+{
+	return Stats::snapshot().toHash()["counters"].toHash()[name].toLongLong();
+}
+
+class WorkerTest : public QObject
+{
+	Q_OBJECT
+
+private:
+	class Packet
+	{
+	public:
+		ZhttpResponsePacket resp;
+		qint64 time;
+	};
+
+	QElapsedTimer clock;
+	QList<Packet> packets;
+	bool finished;
+
+	// streams a GET with the given credits, collecting data packets
+	Worker *startStream(AppConfig *config, const QString &uri, int credits, const ZhttpCodec::RequestExtras &extras = ZhttpCodec::RequestExtras())
+	{
+		packets.clear();
+		finished = false;
+		clock.start();
+
+		Worker *w = new Worker(config, Worker::TnetStringFormat);
+
+		connect(w, &Worker::readyRead, [=](const QByteArray &receiver, const ZhttpResponsePacket &resp) {
+			Q_UNUSED(receiver);
+			if(resp.type == ZhttpResponsePacket::Data)
+			{
+				Packet p;
+				p.resp = resp;
+				p.time = clock.elapsed();
+				packets += p;
+			}
+		});
+		connect(w, &Worker::finished, [=]() { finished = true; });
+
+		w->setRequestExtras(extras);
+
+		ZhttpRequestPacket req;
+		req.from = "test";
+		req.type = ZhttpRequestPacket::Data;
+		req.method = "GET";
+		req.uri = QUrl(uri);
+		req.stream = true;
+		req.credits = credits;
+		req.ignorePolicies = true;
+		w->start("1", 0, req, Worker::Stream);
+
+		return w;
+	}
+
+	int bodyBytes() const
+	{
+		int total = 0;
+		foreach(const Packet &p, packets)
+			total += p.resp.body.size();
+		return total;
+	}
+
+private slots:
+	void hostQueueFull()
+	{
+		AppConfig config;
+		initConfig(&config);
+
+		// fill the host's slot and its queue
+		HostLimiter limiter(1, 1);
+		QObject a, b;
+		QCOMPARE(limiter.acquire("example.com:80", &a, []() {}), HostLimiter::Acquired);
+		QCOMPARE(limiter.acquire("example.com:80", &b, []() {}), HostLimiter::Queued);
+
+		Worker w(&config, Worker::TnetStringFormat);
+		w.setHostLimiter(&limiter);
+
+		QList<ZhttpResponsePacket> responses;
+		bool finished = false;
+		connect(&w, &Worker::readyRead, [&](const QByteArray &receiver, const ZhttpResponsePacket &resp) {
+			Q_UNUSED(receiver);
+			responses += resp;
+		});
+		connect(&w, &Worker::finished, [&]() { finished = true; });
+
+		ZhttpRequestPacket req;
+		req.from = "test";
+		req.type = ZhttpRequestPacket::Data;
+		req.method = "GET";
+		req.uri = QUrl("http://example.com/");
+		req.stream = true;
+		req.ignorePolicies = true;
+		w.start("1", 0, req, Worker::Stream);
+
+		QTRY_VERIFY(finished);
+
+		// a local overflow must not look like an upstream rejection
+		QCOMPARE(responses.count(), 1);
+		QCOMPARE(responses[0].type, ZhttpResponsePacket::Error);
+		QCOMPARE(responses[0].condition, QByteArray("undefined-condition"));
+
+		limiter.release("example.com:80", &b);
+		limiter.release("example.com:80", &a);
+	}
+
+	void flushCoalescesSmallReads()
+	{
+		AppConfig config;
+		initConfig(&config);
+		config.flushSize = 1000;
+		config.flushDelay = 2000;
+
+		TrickleServer server;
+		for(int n = 0; n < 30; ++n)
+			server.addPiece(10, 100);
+		QVERIFY(server.listen());
+
+		Worker *w = startStream(&config, server.uri(), 100000);
+		QTRY_VERIFY_WITH_TIMEOUT(finished, 10000);
+		delete w;
+
+		QCOMPARE(bodyBytes(), 3000);
+		QVERIFY(!packets.last().resp.more);
+
+		// the first packet carries the header and is never held, and the
+		//   last one ends the body. everything between waits for size
+		for(int n = 1; n < packets.count() - 1; ++n)
+			QVERIFY(packets[n].resp.body.size() >= 1000);
+	}
+
+	void flushTrickleWithinDelay()
+	{
+		AppConfig config;
+		initConfig(&config);
+		config.flushSize = 100000;
+		config.flushDelay = 50;
+
+		TrickleServer server;
+		server.addPiece(100, 10);
+		server.addPiece(3000, 10);
+		QVERIFY(server.listen());
+
+		Worker *w = startStream(&config, server.uri(), 100000);
+
+		// the first piece goes out on the delay, well before the second
+		//   piece would complete the body
+		QTRY_COMPARE_WITH_TIMEOUT(bodyBytes(), 10, 2000);
+		QCOMPARE(server.written, 10);
+		QVERIFY(packets.last().resp.more);
+
+		QTRY_VERIFY_WITH_TIMEOUT(finished, 10000);
+		delete w;
+
+		QCOMPARE(bodyBytes(), 20);
+	}
+
+	void flushPartialReadStaysDue()
+	{
+		AppConfig config;
+		initConfig(&config);
+		config.flushSize = 1000;
+		config.flushDelay = 2000;
+
+		TrickleServer server;
+		server.addPiece(100, 1500);
+		server.addPiece(5000, 500);
+		QVERIFY(server.listen());
+
+		Worker *w = startStream(&config, server.uri(), 1000);
+
+		// the read is cut short by credits
+		QTRY_COMPARE_WITH_TIMEOUT(bodyBytes(), 1000, 2000);
+		QTest::qWait(100);
+		QCOMPARE(bodyBytes(), 1000);
+
+		// the rest was due already, so it goes out as soon as credits
+		//   arrive rather than after another delay
+		ZhttpRequestPacket req;
+		req.from = "test";
+		req.type = ZhttpRequestPacket::Credit;
+		req.credits = 100000;
+		w->write(1, req);
+
+		qint64 creditsTime = clock.elapsed();
+		QTRY_COMPARE_WITH_TIMEOUT(bodyBytes(), 1500, 2000);
+		QVERIFY(packets.last().time - creditsTime < 1000);
+		QCOMPARE(server.written, 1500);
+
+		delete w;
+	}
+
+	void flushOnFinish()
+	{
+		AppConfig config;
+		initConfig(&config);
+		config.flushSize = 100000;
+		config.flushDelay = 5000;
+
+		TrickleServer server;
+		server.addPiece(100, 10);
+		QVERIFY(server.listen());
+
+		Worker *w = startStream(&config, server.uri(), 100000);
+		QTRY_VERIFY_WITH_TIMEOUT(finished, 10000);
+		delete w;
+
+		// the end of the body is sent without waiting out the delay
+		QCOMPARE(bodyBytes(), 10);
+		QVERIFY(!packets.last().resp.more);
+		QVERIFY(packets.last().time < 2500);
+	}
+
+	void prewarmParksConnections()
+	{
+		AppConfig config;
+		initConfig(&config);
+
+		KeepAliveServer server;
+		QVERIFY(server.listen());
+
+		qint64 opened = statsCounter("connections-opened");
+		qint64 reused = statsCounter("connections-reused");
+
+		ZhttpCodec::RequestExtras extras;
+		extras.prewarm = true;
+		extras.prewarmCount = 3;
+
+		Worker *w = startStream(&config, server.uri(), 100000, extras);
+		QTRY_VERIFY_WITH_TIMEOUT(finished, 10000);
+		delete w;
+
+		// the response waits for all of the connections
+		QVERIFY(!packets.isEmpty());
+		QCOMPARE(packets.first().resp.code, 204);
+		QCOMPARE(bodyBytes(), 0);
+		QCOMPARE(server.connections, 3);
+		QCOMPARE(server.methods, QList<QByteArray>() << "HEAD" << "HEAD" << "HEAD");
+		QCOMPARE(statsCounter("connections-opened") - opened, (qint64)3);
+
+		// the next request finds a connection ready
+		w = startStream(&config, server.uri(), 100000);
+		QTRY_VERIFY_WITH_TIMEOUT(finished, 10000);
+		delete w;
+
+		QCOMPARE(packets.first().resp.code, 200);
+		QCOMPARE(bodyBytes(), 6);
+		QCOMPARE(server.connections, 3);
+		QCOMPARE(statsCounter("connections-opened") - opened, (qint64)3);
+		QCOMPARE(statsCounter("connections-reused") - reused, (qint64)1);
+	}
+};
+
+QTEST_MAIN(WorkerTest)
+#include "workertest.moc"
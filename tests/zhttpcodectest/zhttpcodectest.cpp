@@ -0,0 +1,385 @@
+/*
+ * Copyright (C) 2026 Fanout, Inc.
+ *
+ * This file is part of Zurl.
+ *
+ * $FANOUT_BEGIN_LICENSE:GPL$
+ *
+ * Zurl is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zurl is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Zurl may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#include <QtTest/QtTest>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include "tnetstring.h"
+#include "zhttprequestpacket.h"
+#include "zhttpresponsepacket.h"
+#include "zhttpcodec.h"
+
+static bool decodeVariant(const QByteArray &message, ZhttpRequestPacket *p)
+{
+	QVariant data;
+	if(message[0] == 'T')
+	{
+		bool ok;
+		data = TnetString::toVariant(message, 1, &ok);
+		if(!ok)
+			return false;
+	}
+	else
+	{
+		QJsonParseError e;
+		QJsonDocument doc = QJsonDocument::fromJson(message.mid(1), &e);
+		if(e.error != QJsonParseError::NoError || !doc.isObject())
+			return false;
+
+		data = ZhttpCodec::convertFromJsonStyle(doc.object().toVariantMap());
+	}
+
+	return p->fromVariant(data);
+}
+
+static ZhttpRequestPacket makeRequest(int headerCount)
+{
+	ZhttpRequestPacket p;
+	p.from = "pushpin-proxy_1234";
+	p.ids += ZhttpRequestPacket::Id("5f2d9a31-0c6e-4a0b-9e0d-6f5b3e8c4a21", 0);
+	p.method = "POST";
+	p.uri = QUrl("http://example.com/path/to/resource?a=1&b=2");
+	for(int n = 0; n < headerCount; ++n)
+		p.headers += HttpHeader("X-Header-" + QByteArray::number(n), "value " + QByteArray::number(n));
+	p.body = QByteArray(1000, 'x');
+	p.stream = true;
+	p.credits = 200000;
+	p.connectHost = "127.0.0.1";
+	p.connectPort = 8080;
+	p.ignoreTlsErrors = true;
+
+	QVariantHash userData;
+	userData["nested"] = QVariantList() << QByteArray("a") << 2 << true;
+	p.userData = userData;
+
+	return p;
+}
+
+static QByteArray toTnet(const ZhttpRequestPacket &p)
+{
+	return "T" + TnetString::fromVariant(p.toVariant());
+}
+
+// bytes become strings, as zhttp peers send them in json
+static QVariant toJsonStyle(const QVariant &in)
+{
+	if(in.type() == QVariant::Hash)
+	{
+		QVariantMap out;
+		QVariantHash h = in.toHash();
+		QHashIterator<QString, QVariant> it(h);
+		while(it.hasNext())
+		{
+			it.next();
+			out[it.key()] = toJsonStyle(it.value());
+		}
+		return out;
+	}
+	else if(in.type() == QVariant::List)
+	{
+		QVariantList out;
+		foreach(const QVariant &i, in.toList())
+			out += toJsonStyle(i);
+		return out;
+	}
+	else if(in.type() == QVariant::ByteArray)
+	{
+		return QString::fromUtf8(in.toByteArray());
+	}
+	else
+		return in;
+}
+
+static QByteArray toJson(const ZhttpRequestPacket &p)
+{
+	QJsonDocument doc(QJsonObject::fromVariantMap(toJsonStyle(p.toVariant()).toMap()));
+	return "J" + doc.toJson(QJsonDocument::Compact);
+}
+
+static ZhttpResponsePacket makeResponse(int bodySize)
+{
+	ZhttpResponsePacket p;
+	p.from = "zurl_1234";
+	p.ids += ZhttpResponsePacket::Id("5f2d9a31-0c6e-4a0b-9e0d-6f5b3e8c4a21", 12);
+	p.code = 200;
+	p.reason = "OK";
+	p.headers += HttpHeader("Content-Type", "text/plain");
+	p.headers += HttpHeader("Content-Length", QByteArray::number(bodySize));
+	p.body = QByteArray(bodySize, 'x');
+	p.more = true;
+	p.credits = 1000;
+
+	QVariantHash userData;
+	userData["nested"] = QVariantList() << QByteArray("a") << 2 << true;
+	p.userData = userData;
+
+	return p;
+}
+
+static QByteArray encodeVariant(const ZhttpResponsePacket &p, char format)
+{
+	if(format == 'T')
+		return "T" + TnetString::fromVariant(p.toVariant());
+
+	QVariant data = ZhttpCodec::convertToJsonStyle(p.toVariant());
+	return "J" + QJsonDocument(QJsonObject::fromVariantMap(data.toMap())).toJson(QJsonDocument::Compact);
+}
+
+static QVariant parseEncoded(const QByteArray &message)
+{
+	if(message[0] == 'T')
+	{
+		bool ok;
+		return TnetString::toVariant(message, 1, &ok);
+	}
+
+	QJsonDocument doc = QJsonDocument::fromJson(message.mid(1));
+	return ZhttpCodec::convertFromJsonStyle(doc.object().toVariantMap());
+}
+
+class ZhttpCodecTest : public QObject
+{
+	Q_OBJECT
+
+private:
+	void compare(const QByteArray &message)
+	{
+		ZhttpRequestPacket a, b;
+		QVERIFY(decodeVariant(message, &a));
+		QVERIFY(ZhttpCodec::parseRequest(message, &b));
+		QCOMPARE(b.toVariant(), a.toVariant());
+	}
+
+	void compareResponse(const ZhttpResponsePacket &p)
+	{
+		QByteArray t = ZhttpCodec::serializeResponse(p, 'T');
+		QVERIFY(!t.isEmpty());
+		QCOMPARE(parseEncoded(t), parseEncoded(encodeVariant(p, 'T')));
+
+		QByteArray j = ZhttpCodec::serializeResponse(p, 'J');
+		QVERIFY(!j.isEmpty());
+		QCOMPARE(parseEncoded(j), parseEncoded(encodeVariant(p, 'J')));
+	}
+
+private slots:
+	void tnetRequest()
+	{
+		compare(toTnet(makeRequest(10)));
+	}
+
+	void jsonRequest()
+	{
+		compare(toJson(makeRequest(10)));
+	}
+
+	void streamPackets()
+	{
+		ZhttpRequestPacket p;
+		p.from = "pushpin-proxy_1234";
+		p.ids += ZhttpRequestPacket::Id("a", 3);
+		p.type = ZhttpRequestPacket::Credit;
+		p.credits = 1000;
+		compare(toTnet(p));
+		compare(toJson(p));
+
+		p.type = ZhttpRequestPacket::KeepAlive;
+		p.credits = -1;
+		compare(toTnet(p));
+		compare(toJson(p));
+
+		p.ids += ZhttpRequestPacket::Id("b", 7);
+		p.multi = true;
+		compare(toTnet(p));
+		compare(toJson(p));
+	}
+
+	void jsonEscapes()
+	{
+		compare("J{\"from\":\"a\\u00e9\\ud83d\\ude00\\n\",\"id\":\"1\",\"seq\":0,\"method\":\"GET\",\"uri\":\"http://example.com/\"}");
+	}
+
+	void fallback()
+	{
+		ZhttpRequestPacket p;
+
+		// unknown field
+		QVERIFY(!ZhttpCodec::parseRequest("J{\"id\":\"1\",\"foo\":1}", &p));
+
+		// non-integral number
+		QVERIFY(!ZhttpCodec::parseRequest("J{\"id\":\"1\",\"seq\":1.5}", &p));
+
+		// truncated
+		QVERIFY(!ZhttpCodec::parseRequest("T20:2:id,1:1,", &p));
+		QVERIFY(!ZhttpCodec::parseRequest("J{\"id\":\"1\"", &p));
+
+		// trailing garbage
+		QVERIFY(!ZhttpCodec::parseRequest("J{\"id\":\"1\"}x", &p));
+
+		// invalid utf-8 in json string
+		QVERIFY(!ZhttpCodec::parseRequest("J{\"id\":\"\xff\"}", &p));
+	}
+
+	void deepNesting()
+	{
+		ZhttpRequestPacket p;
+
+		QByteArray tnet = "0:]";
+		QByteArray json = "[]";
+		for(int n = 1; n < 10000; ++n)
+		{
+			tnet = QByteArray::number(tnet.size()) + ':' + tnet + ']';
+			json = '[' + json + ']';
+
+			// moderate nesting is still decoded directly
+			if(n == 10)
+			{
+				QByteArray tnetMap = "4:from,1:a,2:id,1:1,9:user-data," + tnet;
+				compare('T' + QByteArray::number(tnetMap.size()) + ':' + tnetMap + '}');
+				compare("J{\"from\":\"a\",\"id\":\"1\",\"user-data\":" + json + "}");
+			}
+		}
+
+		// rejected rather than recursing without bound
+		QByteArray tnetMap = "4:from,1:a,2:id,1:1,9:user-data," + tnet;
+		QVERIFY(!ZhttpCodec::parseRequest('T' + QByteArray::number(tnetMap.size()) + ':' + tnetMap + '}', &p));
+		QVERIFY(!ZhttpCodec::parseRequest("J{\"from\":\"a\",\"id\":\"1\",\"user-data\":" + json + "}", &p));
+
+		// also when skipping unknown keys in an id map
+		QVERIFY(!ZhttpCodec::parseRequest("J{\"id\":[{\"id\":\"1\",\"x\":" + json + "}]}", &p));
+	}
+
+	void responses()
+	{
+		compareResponse(makeResponse(100));
+
+		ZhttpResponsePacket p;
+		p.from = "zurl_1234";
+		p.ids += ZhttpResponsePacket::Id("a", 0);
+		p.ids += ZhttpResponsePacket::Id("b", 5);
+		p.type = ZhttpResponsePacket::KeepAlive;
+		p.multi = true;
+		compareResponse(p);
+
+		p = ZhttpResponsePacket();
+		p.ids += ZhttpResponsePacket::Id("a", 1);
+		p.type = ZhttpResponsePacket::Error;
+		p.condition = "remote-connection-failed";
+		compareResponse(p);
+
+		p = ZhttpResponsePacket();
+		p.ids += ZhttpResponsePacket::Id("a", 2);
+		p.type = ZhttpResponsePacket::Close;
+		p.code = 1000;
+		p.body = "bye";
+		compareResponse(p);
+
+		// escaping and invalid utf-8
+		p = makeResponse(0);
+		p.body = "quote\"back\\slash\x01\n\xc3\xa9\xff";
+		compareResponse(p);
+	}
+
+	void responsePrefix()
+	{
+		ZhttpResponsePacket p = makeResponse(10);
+		QByteArray out = ZhttpCodec::serializeResponse(p, 'T', "receiver");
+		QVERIFY(out.startsWith("receiver T"));
+		QCOMPARE(parseEncoded(out.mid(9)), parseEncoded(encodeVariant(p, 'T')));
+	}
+
+	void benchmarkVariantTnet()
+	{
+		QByteArray message = toTnet(makeRequest(10));
+		QBENCHMARK {
+			ZhttpRequestPacket p;
+			decodeVariant(message, &p);
+		}
+	}
+
+	void benchmarkDirectTnet()
+	{
+		QByteArray message = toTnet(makeRequest(10));
+		QBENCHMARK {
+			ZhttpRequestPacket p;
+			ZhttpCodec::parseRequest(message, &p);
+		}
+	}
+
+	void benchmarkVariantJson()
+	{
+		QByteArray message = toJson(makeRequest(10));
+		QBENCHMARK {
+			ZhttpRequestPacket p;
+			decodeVariant(message, &p);
+		}
+	}
+
+	void benchmarkDirectJson()
+	{
+		QByteArray message = toJson(makeRequest(10));
+		QBENCHMARK {
+			ZhttpRequestPacket p;
+			ZhttpCodec::parseRequest(message, &p);
+		}
+	}
+
+	void benchmarkEncodeVariantTnet()
+	{
+		ZhttpResponsePacket p = makeResponse(16384);
+		QBENCHMARK {
+			QByteArray out = "receiver " + encodeVariant(p, 'T');
+		}
+	}
+
+	void benchmarkEncodeDirectTnet()
+	{
+		ZhttpResponsePacket p = makeResponse(16384);
+		QBENCHMARK {
+			ZhttpCodec::serializeResponse(p, 'T', "receiver");
+		}
+	}
+
+	void benchmarkEncodeVariantJson()
+	{
+		ZhttpResponsePacket p = makeResponse(16384);
+		QBENCHMARK {
+			QByteArray out = "receiver " + encodeVariant(p, 'J');
+		}
+	}
+
+	void benchmarkEncodeDirectJson()
+	{
+		ZhttpResponsePacket p = makeResponse(16384);
+		QBENCHMARK {
+			ZhttpCodec::serializeResponse(p, 'J', "receiver");
+		}
+	}
+};
+
+QTEST_MAIN(ZhttpCodecTest)
+#include "zhttpcodectest.moc"
@@ -0,0 +1,178 @@
+/*
+ * Copyright (C) 2026 Fanout, Inc.
+ *
+ * This file is part of Zurl.
+ *
+ * $FANOUT_BEGIN_LICENSE:GPL$
+ *
+ * Zurl is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Zurl is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Alternatively, Zurl may be used under the terms of a commercial license,
+ * where the commercial license agreement is provided with the software or
+ * contained in a written agreement between you and Fanout. For further
+ * information use the contact form at <https://fanout.io/enterprise/>.
+ *
+ * $FANOUT_END_LICENSE$
+ */
+
+#include <QtTest/QtTest>
+#include <zmq.h>
+#include "zhttpresponsepacket.h"
+#include "zhttpcodec.h"
+#include "zmqpublisher.h"
+
+#define BODY_SIZE (4 * 1024 * 1024)
+
+static ZhttpResponsePacket makeResponse()
+{
+	ZhttpResponsePacket p;
+	p.from = "zurl_1234";
+	p.ids += ZhttpResponsePacket::Id("5f2d9a31-0c6e-4a0b-9e0d-6f5b3e8c4a21", 0);
+	p.code = 200;
+	p.reason = "OK";
+	p.headers += HttpHeader("Content-Type", "application/octet-stream");
+	p.body = QByteArray(BODY_SIZE, 'x');
+	return p;
+}
+
+class ZmqPublisherTest : public QObject
+{
+	Q_OBJECT
+
+private slots:
+	void receive()
+	{
+		// the publisher has its own context, so inproc can't be used here
+		ZmqPublisher pub;
+		QString spec = QString("ipc://%1/zmqpublishertest-%2").arg(QDir::tempPath()).arg(QCoreApplication::applicationPid());
+		QVERIFY(pub.bind(spec));
+
+		void *context = zmq_ctx_new();
+		void *sub = zmq_socket(context, ZMQ_SUB);
+		zmq_setsockopt(sub, ZMQ_SUBSCRIBE, "receiver ", 9);
+		int timeout = 5000;
+		zmq_setsockopt(sub, ZMQ_RCVTIMEO, &timeout, sizeof(timeout));
+		QCOMPARE(zmq_connect(sub, spec.toUtf8().data()), 0);
+
+		QByteArray big = ZhttpCodec::serializeResponse(makeResponse(), 'T', "receiver");
+		QByteArray small = "receiver T0:}";
+
+		// subscriptions propagate asynchronously, so publish until one
+		//   gets through
+		zmq_msg_t msg;
+		zmq_msg_init(&msg);
+		bool received = false;
+		for(int n = 0; n < 50 && !received; ++n)
+		{
+			pub.write(small);
+			pub.write(big);
+			if(zmq_msg_recv(&msg, sub, ZMQ_DONTWAIT) != -1)
+				received = true;
+			else
+				QTest::qWait(20);
+		}
+		QVERIFY(received);
+
+		// small first, then big
+		QCOMPARE(QByteArray((const char *)zmq_msg_data(&msg), zmq_msg_size(&msg)), small);
+		QVERIFY(zmq_msg_recv(&msg, sub, 0) != -1);
+		QCOMPARE(QByteArray((const char *)zmq_msg_data(&msg), zmq_msg_size(&msg)), big);
+		zmq_msg_close(&msg);
+
+		zmq_close(sub);
+		zmq_ctx_term(context);
+		QFile::remove(spec.mid(6));
+	}
+
+	void sharedContext()
+	{
+		void *context = zmq_ctx_new();
+
+		// publishers on a shared context are reachable over inproc from
+		//   that context
+		ZmqPublisher *a = new ZmqPublisher(context);
+		ZmqPublisher *b = new ZmqPublisher(context);
+		QVERIFY(a->bind("inproc://sharedcontext-a"));
+		QVERIFY(b->bind("inproc://sharedcontext-b"));
+
+		void *sub = zmq_socket(context, ZMQ_SUB);
+		zmq_setsockopt(sub, ZMQ_SUBSCRIBE, "", 0);
+		int timeout = 5000;
+		zmq_setsockopt(sub, ZMQ_RCVTIMEO, &timeout, sizeof(timeout));
+		QCOMPARE(zmq_connect(sub, "inproc://sharedcontext-a"), 0);
+		QCOMPARE(zmq_connect(sub, "inproc://sharedcontext-b"), 0);
+
+		zmq_msg_t msg;
+		zmq_msg_init(&msg);
+		QSet<QByteArray> received;
+		for(int n = 0; n < 50 && received.count() < 2; ++n)
+		{
+			a->write("a");
+			b->write("b");
+			while(zmq_msg_recv(&msg, sub, ZMQ_DONTWAIT) != -1)
+				received += QByteArray((const char *)zmq_msg_data(&msg), zmq_msg_size(&msg));
+			if(received.count() < 2)
+				QTest::qWait(20);
+		}
+		zmq_msg_close(&msg);
+		QCOMPARE(received, QSet<QByteArray>() << "a" << "b");
+
+		// the context is left open by the publishers
+		delete a;
+		delete b;
+		zmq_close(sub);
+		zmq_ctx_term(context);
+	}
+
+	// prefix concatenation plus a copying send, as before
+	void benchmarkCopy()
+	{
+		ZhttpResponsePacket p = makeResponse();
+		QByteArray receiver = "receiver";
+
+		void *context = zmq_ctx_new();
+		void *pub = zmq_socket(context, ZMQ_PUB);
+		zmq_bind(pub, "inproc://benchmarkcopy");
+
+		QBENCHMARK {
+			QByteArray part = ZhttpCodec::serializeResponse(p, 'T');
+			QByteArray buf = receiver + ' ' + part;
+
+			zmq_msg_t msg;
+			zmq_msg_init_size(&msg, buf.size());
+			memcpy(zmq_msg_data(&msg), buf.constData(), buf.size());
+			if(zmq_msg_send(&msg, pub, ZMQ_DONTWAIT) == -1)
+				zmq_msg_close(&msg);
+		}
+
+		zmq_close(pub);
+		zmq_ctx_term(context);
+	}
+
+	void benchmarkZeroCopy()
+	{
+		ZhttpResponsePacket p = makeResponse();
+		QByteArray receiver = "receiver";
+
+		ZmqPublisher pub;
+		pub.bind("inproc://benchmarkzerocopy");
+
+		QBENCHMARK {
+			pub.write(ZhttpCodec::serializeResponse(p, 'T', receiver));
+		}
+	}
+};
+
+QTEST_MAIN(ZmqPublisherTest)
+#include "zmqpublishertest.moc"